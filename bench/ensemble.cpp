@@ -0,0 +1,22 @@
+// Root-parallel MCTS ensemble against one tree at the same time per move: a single-threaded
+// tree and a tree-parallel one with as many threads as the ensemble has trees.
+// Usage: ensemble [seconds per move] [trees] [matches]
+
+#include "tic_tac_toe.h"
+
+int main(int argc, char **argv) {
+    const double seconds = argc > 1 ? atof(argv[1]) : 0.1;
+    const int trees = argc > 2 ? atoi(argv[2]) : 4;
+    const int matches = argc > 3 ? atoi(argv[3]) : 20;
+    TicTacToeState root;
+    // The ensemble seeds its trees with 0 .. trees - 1, the opponents come after that
+    EnsembleMonteCarloTreeSearch<TicTacToeState, TicTacToeMove> ensemble(seconds, trees, MAX_SIMULATIONS, false, MCTS_MAX_NODES, 0);
+    MonteCarloTreeSearch<TicTacToeState, TicTacToeMove> single(seconds, MAX_SIMULATIONS, false, 1, MCTS_MAX_NODES, max(trees, 1));
+    MonteCarloTreeSearch<TicTacToeState, TicTacToeMove> shared(seconds, MAX_SIMULATIONS, false, trees, MCTS_MAX_NODES, max(trees, 1) + 1);
+    cout << "ensemble of " << trees << " against a single-threaded tree" << endl;
+    Tester<TicTacToeState, TicTacToeMove>(&root, ensemble, single, matches).start();
+    ensemble.clear();
+    cout << "ensemble of " << trees << " against a tree with " << trees << " threads" << endl;
+    Tester<TicTacToeState, TicTacToeMove>(&root, ensemble, shared, matches).start();
+    return 0;
+}
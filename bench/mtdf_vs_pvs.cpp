@@ -0,0 +1,54 @@
+// MTD(f) against the aspiration PVS of Minimax on the positions of one self-play game:
+// per depth, the nodes, researches and seconds to depth of each driver, summed over the positions.
+// Usage: mtdf_vs_pvs [seconds per search]
+
+#include "tic_tac_toe.h"
+
+struct DepthTotals {
+    long long nodes = 0;
+    long long researches = 0;
+    double seconds = 0;
+    int positions = 0;
+};
+
+template<class A>
+TicTacToeMove add_totals(A &algorithm, const TicTacToeState &state, vector<DepthTotals> &totals) {
+    algorithm.clear();
+    const auto move = algorithm.get_move(&state);
+    for (const auto &stats : algorithm.depth_stats) {
+        if (totals.size() <= stats.depth) {
+            totals.resize(stats.depth + 1);
+        }
+        DepthTotals &depth = totals[stats.depth];
+        depth.nodes += stats.nodes;
+        depth.researches += stats.researches;
+        depth.seconds += stats.seconds;
+        ++depth.positions;
+    }
+    return move;
+}
+
+int main(int argc, char **argv) {
+    const double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+    Minimax<TicTacToeState, TicTacToeMove> pvs(seconds);
+    MTDf<TicTacToeState, TicTacToeMove> mtdf(seconds);
+    vector<DepthTotals> pvs_totals, mtdf_totals;
+    TicTacToeState state;
+    while (!state.is_terminal()) {
+        add_totals(mtdf, state, mtdf_totals);
+        state.make_move(add_totals(pvs, state, pvs_totals));
+    }
+    cout << "depth positions pvs_nodes pvs_researches pvs_seconds mtdf_nodes mtdf_researches mtdf_seconds" << endl;
+    for (int depth = 1; depth < min(pvs_totals.size(), mtdf_totals.size()); ++depth) {
+        const auto &p = pvs_totals[depth];
+        const auto &m = mtdf_totals[depth];
+        // Only depths both drivers completed everywhere are comparable
+        if (p.positions != m.positions) {
+            break;
+        }
+        cout << depth << " " << p.positions
+        << " " << p.nodes << " " << p.researches << " " << p.seconds
+        << " " << m.nodes << " " << m.researches << " " << m.seconds << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,25 @@
+// Minimax nodes per second over the positions of one self-play game, for comparing
+// builds before and after a change: the median and every search are printed.
+// Usage: nps [seconds per search]
+
+#include "tic_tac_toe.h"
+
+int main(int argc, char **argv) {
+    const double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+    Minimax<TicTacToeState, TicTacToeMove> minimax(seconds);
+    TicTacToeState state;
+    vector<long long> nps;
+    cout << "ply nodes seconds nps" << endl;
+    for (int ply = 0; !state.is_terminal(); ++ply) {
+        Timer timer;
+        timer.start();
+        const auto move = minimax.get_move(&state);
+        const double elapsed = timer.seconds_elapsed();
+        nps.push_back((long long) (minimax.total_nodes / elapsed));
+        cout << ply << " " << minimax.total_nodes << " " << elapsed << " " << nps.back() << endl;
+        state.make_move(move);
+    }
+    sort(nps.begin(), nps.end());
+    cout << "median nps: " << nps[nps.size() / 2] << endl;
+    return 0;
+}
@@ -0,0 +1,20 @@
+// Lazy SMP time to depth: the same position searched with 1, 2, 4, ... threads,
+// printing the seconds at which each depth completed.
+// Usage: smp_scaling [seconds per search] [max threads]
+
+#include "tic_tac_toe.h"
+
+int main(int argc, char **argv) {
+    const double seconds = argc > 1 ? atof(argv[1]) : 2;
+    const int max_threads = argc > 2 ? atoi(argv[2]) : 16;
+    const TicTacToeState root;
+    cout << "threads depth seconds nodes" << endl;
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        Minimax<TicTacToeState, TicTacToeMove> minimax(seconds, INF, TT_MEGABYTES, false, threads);
+        minimax.get_move(&root);
+        for (const auto &stats : minimax.depth_stats) {
+            cout << threads << " " << stats.depth << " " << stats.seconds << " " << stats.nodes << endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+// 4x4 tic-tac-toe, small enough to search to the end, used by the benchmark drivers
+// and the tests. A player wins with a full row, column or diagonal.
+
+#include "gtsa.hpp"
+
+static const char TIC_TAC_TOE_PLAYER_1 = '1';
+static const char TIC_TAC_TOE_PLAYER_2 = '2';
+static const char TIC_TAC_TOE_EMPTY = '_';
+static const int TIC_TAC_TOE_SIDE = 4;
+
+struct TicTacToeMove : public Move<TicTacToeMove> {
+    unsigned x = 0;
+    unsigned y = 0;
+
+    TicTacToeMove() {}
+
+    TicTacToeMove(unsigned x, unsigned y) : x(x), y(y) {}
+
+    void read(istream &stream = cin) override {
+        stream >> x >> y;
+    }
+
+    ostream &to_stream(ostream &os) const override {
+        return os << x << " " << y;
+    }
+
+    bool operator==(const TicTacToeMove &rhs) const override {
+        return x == rhs.x && y == rhs.y;
+    }
+
+    size_t hash() const override {
+        return x * TIC_TAC_TOE_SIDE + y;
+    }
+};
+
+struct TicTacToeState : public State<TicTacToeState, TicTacToeMove> {
+    vector<char> board;
+
+    TicTacToeState() :
+            State(TIC_TAC_TOE_PLAYER_1),
+            board(TIC_TAC_TOE_SIDE * TIC_TAC_TOE_SIDE, TIC_TAC_TOE_EMPTY) {}
+
+    // Rows like "1__2/____/____/____" with the player to move
+    TicTacToeState(const string &rows, char player_to_move) : TicTacToeState() {
+        this->player_to_move = player_to_move;
+        int i = 0;
+        for (char c : rows) {
+            if (c != '/') {
+                board[i++] = c;
+            }
+        }
+    }
+
+    TicTacToeState clone() const {
+        return *this;
+    }
+
+    char get(int x, int y) const {
+        return board[x * TIC_TAC_TOE_SIDE + y];
+    }
+
+    // Sum of squared piece counts over rows and columns
+    int count_lines(char player) const {
+        int score = 0;
+        for (int i = 0; i < TIC_TAC_TOE_SIDE; ++i) {
+            int row = 0;
+            int column = 0;
+            for (int j = 0; j < TIC_TAC_TOE_SIDE; ++j) {
+                row += get(i, j) == player;
+                column += get(j, i) == player;
+            }
+            score += row * row + column * column;
+        }
+        return score;
+    }
+
+    int get_goodness() const {
+        const char enemy = get_enemy(player_to_move);
+        if (is_winner(player_to_move)) {
+            return 1000;
+        }
+        if (is_winner(enemy)) {
+            return -1000;
+        }
+        return count_lines(player_to_move) - count_lines(enemy);
+    }
+
+    vector<TicTacToeMove> get_legal_moves(int max_moves = INF) const {
+        vector<TicTacToeMove> moves;
+        if (is_terminal()) {
+            return moves;
+        }
+        for (int x = 0; x < TIC_TAC_TOE_SIDE && moves.size() < max_moves; ++x) {
+            for (int y = 0; y < TIC_TAC_TOE_SIDE && moves.size() < max_moves; ++y) {
+                if (get(x, y) == TIC_TAC_TOE_EMPTY) {
+                    moves.push_back(TicTacToeMove(x, y));
+                }
+            }
+        }
+        return moves;
+    }
+
+    // Moves completing a line for either player
+    vector<TicTacToeMove> get_forcing_moves() const {
+        vector<TicTacToeMove> forcing;
+        TicTacToeState state = clone();
+        for (const auto &move : get_legal_moves()) {
+            for (char player : {player_to_move, get_enemy(player_to_move)}) {
+                state.board[move.x * TIC_TAC_TOE_SIDE + move.y] = player;
+                const bool wins = state.is_winner(player);
+                state.board[move.x * TIC_TAC_TOE_SIDE + move.y] = TIC_TAC_TOE_EMPTY;
+                if (wins) {
+                    forcing.push_back(move);
+                    break;
+                }
+            }
+        }
+        return forcing;
+    }
+
+    bool is_endgame() const {
+        return true;
+    }
+
+    char get_enemy(char player) const {
+        return player == TIC_TAC_TOE_PLAYER_1 ? TIC_TAC_TOE_PLAYER_2 : TIC_TAC_TOE_PLAYER_1;
+    }
+
+    bool is_winner(char player) const {
+        bool diagonal = true;
+        bool anti_diagonal = true;
+        for (int i = 0; i < TIC_TAC_TOE_SIDE; ++i) {
+            bool row = true;
+            bool column = true;
+            for (int j = 0; j < TIC_TAC_TOE_SIDE; ++j) {
+                row &= get(i, j) == player;
+                column &= get(j, i) == player;
+            }
+            if (row || column) {
+                return true;
+            }
+            diagonal &= get(i, i) == player;
+            anti_diagonal &= get(i, TIC_TAC_TOE_SIDE - 1 - i) == player;
+        }
+        return diagonal || anti_diagonal;
+    }
+
+    bool is_terminal() const {
+        if (is_winner(TIC_TAC_TOE_PLAYER_1) || is_winner(TIC_TAC_TOE_PLAYER_2)) {
+            return true;
+        }
+        return find(board.begin(), board.end(), TIC_TAC_TOE_EMPTY) == board.end();
+    }
+
+    void make_move(const TicTacToeMove &move) {
+        board[move.x * TIC_TAC_TOE_SIDE + move.y] = player_to_move;
+        player_to_move = get_enemy(player_to_move);
+    }
+
+    void undo_move(const TicTacToeMove &move) {
+        board[move.x * TIC_TAC_TOE_SIDE + move.y] = TIC_TAC_TOE_EMPTY;
+        player_to_move = get_enemy(player_to_move);
+    }
+
+    ostream &to_stream(ostream &os) const {
+        for (int x = 0; x < TIC_TAC_TOE_SIDE; ++x) {
+            for (int y = 0; y < TIC_TAC_TOE_SIDE; ++y) {
+                os << get(x, y);
+            }
+            os << "\n";
+        }
+        return os << player_to_move << "\n";
+    }
+
+    bool operator==(const TicTacToeState &other) const {
+        return player_to_move == other.player_to_move && board == other.board;
+    }
+
+    size_t hash() const {
+        size_t hash = player_to_move;
+        for (char c : board) {
+            hash = hash * 3 + (c == TIC_TAC_TOE_EMPTY ? 0 : c == TIC_TAC_TOE_PLAYER_1 ? 1 : 2);
+        }
+        return hash * 0x9e3779b97f4a7c15;
+    }
+};
@@ -21,16 +21,25 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 #include <boost/math/distributions/binomial.hpp>
 #include <unordered_map>
 #include <unordered_set>
-#include <sys/time.h>
 #include <algorithm>
 #include <iostream>
 #include <assert.h>
+#include <cstdint>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <new>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <memory>
 #include <random>
+#include <thread>
 #include <vector>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 
 using namespace std;
 
@@ -43,34 +52,120 @@ static const double LOSE_SCORE = 0;
 static const int MAX_DEPTH = 20;
 static const int INF = 2147483647;
 
+static const size_t TT_MEGABYTES = 64;
+
+static const int MINIMAX_POLL_INTERVAL = 1024;
+static const int MCTS_POLL_INTERVAL = 16;
+static const int MCTS_REUSE_MAX_PLIES = 4;
+static const int MCTS_MAX_NODES = 1 << 24;
+static const int ARENA_BLOCK_BITS = 16;
+// RAVE is opt-in, AMAF values mislead where the order of the moves matters. Around 500 is a usual start
+static const double MCTS_RAVE_EQUIVALENCE = 0;
+// 0 admits every child. Leaving children out only pays when State::score_move ranks them
+// better than the default tactical before quiet split, as Yinsh's does with its row counts
+static const double MCTS_WIDENING_K = 0;
+static const double MCTS_WIDENING_ALPHA = 0.5;
+static const double SOFT_TIME_RATIO = 0.4;
+
+static const int ASPIRATION_DELTA = 50;
+static const int ASPIRATION_MIN_DEPTH = 3;
+
+static const int LMR_MIN_DEPTH = 3;
+static const int LMR_MIN_MOVES = 3;
+static const int FUTILITY_MAX_DEPTH = 2;
+static const int FUTILITY_MARGIN = 100;
+
+static const int MAX_QUIESCENCE_DEPTH = 8;
+
+static const int MAX_PLY = 64;
+static const int BRANCHING_BUCKETS = 8;
+static const int CUT_POSITION_BUCKETS = 16;
+static const int HISTORY_SIZE = 1 << 16;
+static const int HISTORY_MAX = 1 << 14;
+static const int HELPER_ORDER_NOISE = 256;
+
+// Lazy SMP helper i skips depth d when ((d + SKIP_PHASE[i]) / SKIP_SIZE[i]) is odd,
+// spreading the helpers over neighbouring depths.
+static const int SKIP_SIZE[] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+static const int SKIP_PHASE[] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+typedef uint16_t PackedMove;
+static const PackedMove NO_MOVE = 0;
+
+// xoshiro256** seeded through splitmix64. Small enough to keep one per thread,
+// jump() moves 2^128 draws ahead to split one seed into independent streams.
 struct Random {
+    uint64_t s[4];
+
+    Random(uint64_t seed = 0) {
+        for (auto &word : s) {
+            seed += 0x9e3779b97f4a7c15;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            word = z ^ (z >> 31);
+        }
+    }
 
     virtual ~Random() {}
 
-    int uniform(int min, int max) const {
-        mt19937 engine;
-        uniform_int_distribution<int> distribution(min, max);
-        return distribution(engine);
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    uint64_t next() {
+        const uint64_t result = rotl(s[1] * 5, 7) * 9;
+        const uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    void jump() {
+        static const uint64_t JUMP[] = {0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c};
+        uint64_t jumped[4] = {};
+        for (uint64_t word : JUMP) {
+            for (int b = 0; b < 64; ++b) {
+                if (word & (uint64_t(1) << b)) {
+                    for (int i = 0; i < 4; ++i) {
+                        jumped[i] ^= s[i];
+                    }
+                }
+                next();
+            }
+        }
+        copy(jumped, jumped + 4, s);
+    }
+
+    // Uniform in [min; max], Lemire's multiply and reject keeps it unbiased without a division
+    int uniform(int min, int max) {
+        const uint32_t range = static_cast<uint32_t>(max - min) + 1;
+        uint64_t product = (next() >> 32) * range;
+        if (static_cast<uint32_t>(product) < range) {
+            const uint32_t threshold = -range % range;
+            while (static_cast<uint32_t>(product) < threshold) {
+                product = (next() >> 32) * range;
+            }
+        }
+        return min + static_cast<int>(product >> 32);
     }
 };
 
 struct Timer {
-    double start_time;
+    chrono::steady_clock::time_point start_time;
 
     virtual ~Timer() {}
 
     void start() {
-        start_time = get_time();
-    }
-
-    double get_time() const {
-        timeval tv;
-        gettimeofday(&tv, 0);
-        return tv.tv_sec + tv.tv_usec * 1e-6;
+        start_time = chrono::steady_clock::now();
     }
 
     double seconds_elapsed() const {
-        return get_time() - start_time;
+        return chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
     }
 
     bool exceeded(double seconds) const {
@@ -82,6 +177,49 @@ struct Timer {
     }
 };
 
+// Search clock with a soft limit (do not start another iteration) and a hard limit (abort).
+// poll() is meant to be called at every node and only reads the clock every POLL_INTERVAL calls.
+// The soft limit grows while the best move keeps changing between iterations.
+// on_poll, if set, runs whenever the clock is read and aborts the search by returning true.
+struct TimeManager : public Timer {
+    const int POLL_INTERVAL;
+    function<bool()> on_poll;
+    double soft_seconds = 0;
+    double hard_seconds = 0;
+    double best_move_changes = 0;
+    int polls_left = 0;
+    bool hard_exceeded = false;
+
+    TimeManager(int poll_interval = MINIMAX_POLL_INTERVAL) : POLL_INTERVAL(poll_interval) {}
+
+    void start(double max_seconds) {
+        Timer::start();
+        hard_seconds = max_seconds;
+        soft_seconds = max_seconds * SOFT_TIME_RATIO;
+        best_move_changes = 0;
+        polls_left = POLL_INTERVAL;
+        hard_exceeded = false;
+    }
+
+    bool poll() {
+        if (--polls_left > 0) {
+            return hard_exceeded;
+        }
+        polls_left = POLL_INTERVAL;
+        hard_exceeded = seconds_elapsed() > hard_seconds || (on_poll && on_poll());
+        return hard_exceeded;
+    }
+
+    bool soft_exceeded() const {
+        return hard_exceeded || seconds_elapsed() > soft_seconds;
+    }
+
+    void iteration_completed(bool best_move_changed) {
+        best_move_changes = best_move_changed ? best_move_changes + 1 : best_move_changes / 2;
+        soft_seconds = min(hard_seconds, hard_seconds * SOFT_TIME_RATIO * (1 + best_move_changes));
+    }
+};
+
 template<class M>
 struct Move {
     virtual ~Move() {}
@@ -97,26 +235,31 @@ struct Move {
     virtual bool operator==(const M &rhs) const = 0;
 
     virtual size_t hash() const = 0;
+
+    // 16-bit signature of the move, never NO_MOVE. Stored in the transposition table
+    // and matched against legal moves, so it only has to be unique within one position.
+    virtual PackedMove pack() const {
+        return static_cast<PackedMove>(hash() % 65535 + 1);
+    }
 };
 
 enum TTEntryType { EXACT_VALUE, LOWER_BOUND, UPPER_BOUND };
 
-template<class M>
 struct TTEntry {
-    M move;
+    PackedMove move;
     int depth;
     int value;
     TTEntryType value_type;
+    uint8_t age;
 
     TTEntry() {}
 
-    virtual ~TTEntry() {}
+    TTEntry(PackedMove move, int depth, int value, TTEntryType value_type, uint8_t age = 0) :
+            move(move), depth(depth), value(value), value_type(value_type), age(age) {}
 
-    TTEntry(const M &move, int depth, int value, TTEntryType value_type) :
-            move(move), depth(depth), value(value), value_type(value_type) {}
-
-    ostream &to_stream(ostream &os) {
-        return os << "move: " << move << " depth: " << depth << " value: " << value << " value_type: " << value_type;
+    ostream &to_stream(ostream &os) const {
+        return os << "move: " << move << " depth: " << depth << " value: " << value << " value_type: " << value_type
+                  << " age: " << (int) age;
     }
 
     friend ostream &operator<<(ostream &os, const TTEntry &entry) {
@@ -124,89 +267,328 @@ struct TTEntry {
     }
 };
 
-template<class S, class M>
-struct State {
-    unsigned visits = 0;
-    double score = 0;
-    char player_to_move = 0;
-    S *parent = nullptr;
-    unordered_map<size_t, shared_ptr<S>> children = unordered_map<size_t, shared_ptr<S>>();
+// Fixed-size transposition table: a power-of-two array of cache-line sized buckets.
+// Each slot holds the entry packed into one 64-bit word plus the key XOR-ed with it.
+// Readers recompute the key from both words, so a slot torn by a concurrent writer
+// simply fails verification and no locking is needed between search threads.
+struct TranspositionTable {
+    static const int BUCKET_SLOTS = 4;
+    static const int AGE_MASK = 63;
+
+    struct Slot {
+        atomic<uint64_t> key_xor_data;
+        atomic<uint64_t> data;
+    };
+
+    struct alignas(64) Bucket {
+        Slot slots[BUCKET_SLOTS];
+    };
+
+    Bucket *buckets = nullptr;
+    size_t bucket_count = 0;
+    size_t allocated_bytes = 0;
+    bool mapped = false;
+    uint8_t generation = 0;
+
+    TranspositionTable(size_t megabytes = TT_MEGABYTES, bool huge_pages = false) {
+        resize(megabytes, huge_pages);
+    }
 
-    State(char player_to_move) : player_to_move(player_to_move) {}
+    TranspositionTable(const TranspositionTable&) = delete;
 
-    virtual ~State() {}
+    TranspositionTable &operator=(const TranspositionTable&) = delete;
 
-    void update_stats(double result) {
-        score += result;
-        ++visits;
+    virtual ~TranspositionTable() {
+        deallocate();
     }
 
-    double get_uct(double c) const {
-        assert(visits > 0);
-        double parent_visits = 0.0;
-        if (parent != nullptr) {
-            parent_visits = parent->visits;
+    void resize(size_t megabytes, bool huge_pages = false) {
+        deallocate();
+        const size_t bytes = max<size_t>(megabytes, 1) << 20;
+        bucket_count = 1;
+        while ((bucket_count << 1) * sizeof(Bucket) <= bytes) {
+            bucket_count <<= 1;
+        }
+        allocated_bytes = bucket_count * sizeof(Bucket);
+        void *memory = nullptr;
+#ifdef __linux__
+        if (huge_pages) {
+            memory = mmap(nullptr, allocated_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (memory == MAP_FAILED) {
+                // No reserved huge pages, fall back to transparent ones
+                memory = mmap(nullptr, allocated_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (memory != MAP_FAILED) {
+                    madvise(memory, allocated_bytes, MADV_HUGEPAGE);
+                }
+            }
+            if (memory == MAP_FAILED) {
+                memory = nullptr;
+            } else {
+                mapped = true;
+            }
+        }
+#endif
+        if (memory == nullptr) {
+            memory = aligned_alloc(alignof(Bucket), allocated_bytes);
+        }
+        if (memory == nullptr) {
+            throw bad_alloc();
+        }
+        buckets = static_cast<Bucket*>(memory);
+        for (size_t i = 0; i < bucket_count; ++i) {
+            new (&buckets[i]) Bucket();
+        }
+        clear();
+    }
+
+    void deallocate() {
+        if (buckets == nullptr) {
+            return;
+        }
+#ifdef __linux__
+        if (mapped) {
+            munmap(buckets, allocated_bytes);
+        } else {
+            free(buckets);
+        }
+#else
+        free(buckets);
+#endif
+        buckets = nullptr;
+        mapped = false;
+    }
+
+    void clear() {
+        for (size_t i = 0; i < bucket_count; ++i) {
+            for (auto &slot : buckets[i].slots) {
+                slot.key_xor_data.store(0, memory_order_relaxed);
+                slot.data.store(0, memory_order_relaxed);
+            }
+        }
+        generation = 0;
+    }
+
+    void new_search() {
+        generation = (generation + 1) & AGE_MASK;
+    }
+
+    Bucket &bucket(size_t key) const {
+        return buckets[key & (bucket_count - 1)];
+    }
+
+    void prefetch(size_t key) const {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(&bucket(key));
+#endif
+    }
+
+    // Layout: value (32) | move (16) | depth + 1 (8) | value_type (2) | age (6).
+    // A stored depth of 0 marks an empty slot.
+    static uint64_t pack(const TTEntry &entry) {
+        const uint64_t depth = min(max(entry.depth, 0), 254) + 1;
+        return static_cast<uint64_t>(static_cast<uint32_t>(entry.value))
+               | static_cast<uint64_t>(entry.move) << 32
+               | depth << 48
+               | static_cast<uint64_t>(entry.value_type) << 56
+               | static_cast<uint64_t>(entry.age & AGE_MASK) << 58;
+    }
+
+    static TTEntry unpack(uint64_t data) {
+        return TTEntry(
+            static_cast<PackedMove>(data >> 32),
+            static_cast<int>((data >> 48) & 0xff) - 1,
+            static_cast<int32_t>(static_cast<uint32_t>(data)),
+            static_cast<TTEntryType>((data >> 56) & 3),
+            static_cast<uint8_t>(data >> 58)
+        );
+    }
+
+    static bool is_empty(uint64_t data) {
+        return ((data >> 48) & 0xff) == 0;
+    }
+
+    // A hit on an entry from an earlier search moves it into the current generation,
+    // so positions the game actually reached survive the replacement of stale entries.
+    // The refresh only replaces the words it read: if a store got in between, its entry wins,
+    // and a refresh interleaved with one fails verification like any torn slot.
+    bool probe(size_t key, TTEntry &entry) {
+        const uint64_t key64 = static_cast<uint64_t>(key);
+        for (auto &slot : bucket(key).slots) {
+            const uint64_t data = slot.data.load(memory_order_relaxed);
+            if (is_empty(data)) {
+                continue;
+            }
+            if ((slot.key_xor_data.load(memory_order_relaxed) ^ data) == key64) {
+                entry = unpack(data);
+                if (entry.age != generation) {
+                    TTEntry refreshed_entry = entry;
+                    refreshed_entry.age = generation;
+                    const uint64_t refreshed = pack(refreshed_entry);
+                    uint64_t expected = data;
+                    if (slot.data.compare_exchange_strong(expected, refreshed, memory_order_relaxed)) {
+                        expected = key64 ^ data;
+                        slot.key_xor_data.compare_exchange_strong(expected, key64 ^ refreshed, memory_order_relaxed);
+                    }
+                }
+                return true;
+            }
         }
-        return score / visits + c * sqrt(log(parent_visits) / visits);
+        return false;
     }
 
-    shared_ptr<S> create_child(const M &move) {
-        S child = clone();
-        child.make_move(move);
-        child.parent = (S*) this;
-        return make_shared<S>(child);
+    int relative_age(uint8_t age) const {
+        return (generation - age) & AGE_MASK;
     }
 
-    S* add_child(const M &move) {
-        const auto child = create_child(move);
-        const auto key = move.hash();
-        const auto pair = children.insert({key, child});
-        const auto it = pair.first;
-        return it->second.get();
+    // Overwrites the same position if the new result is not much shallower,
+    // otherwise evicts a slot from an older generation (oldest, then shallowest first),
+    // and only when there is none the shallowest slot of the current one.
+    void store(size_t key, PackedMove move, int depth, int value, TTEntryType value_type) {
+        const uint64_t key64 = static_cast<uint64_t>(key);
+        Bucket &b = bucket(key);
+        Slot *victim = nullptr;
+        int victim_priority = INF;
+        for (auto &slot : b.slots) {
+            const uint64_t data = slot.data.load(memory_order_relaxed);
+            if (!is_empty(data) && (slot.key_xor_data.load(memory_order_relaxed) ^ data) == key64) {
+                const TTEntry old = unpack(data);
+                if (value_type != TTEntryType::EXACT_VALUE && depth + 2 < old.depth && old.age == generation) {
+                    return;
+                }
+                if (move == NO_MOVE) {
+                    move = old.move;
+                }
+                victim = &slot;
+                break;
+            }
+            const int priority = is_empty(data) ? -INF : unpack(data).depth - 256 * relative_age(data >> 58);
+            if (priority < victim_priority) {
+                victim_priority = priority;
+                victim = &slot;
+            }
+        }
+        const uint64_t data = pack(TTEntry(move, depth, value, value_type, generation));
+        victim->data.store(data, memory_order_relaxed);
+        victim->key_xor_data.store(key64 ^ data, memory_order_relaxed);
     }
 
-    S* get_child(const M &move) const {
-        const auto key = move.hash();
-        const auto it = children.find(key);
-        if (it == children.end()) {
-            return nullptr;
+    // Fraction of sampled slots written during the current search.
+    double fill_rate() const {
+        const size_t sample = min<size_t>(bucket_count, 1000);
+        size_t used = 0;
+        for (size_t i = 0; i < sample; ++i) {
+            for (const auto &slot : buckets[i].slots) {
+                const uint64_t data = slot.data.load(memory_order_relaxed);
+                if (!is_empty(data) && (data >> 58) == generation) {
+                    ++used;
+                }
+            }
         }
-        return it->second.get();
+        return (double) used / (sample * BUCKET_SLOTS);
+    }
+};
+
+// Base of every game state, S derives from State<S, M> (CRTP).
+// Algorithms call the game through S*, so the calls are bound at compile time
+// and states carry no vtable. Besides the defaults below, S must provide:
+//     S clone() const;
+//     int get_goodness() const;
+//     vector<M> get_legal_moves(int max_moves = INF) const;
+//     char get_enemy(char player) const;
+//     bool is_terminal() const;
+//     bool is_winner(char player) const;
+//     void make_move(const M &move);
+//     void undo_move(const M &move);
+//     ostream &to_stream(ostream &os) const;
+//     bool operator==(const S &other) const;
+//     size_t hash() const;
+template<class S, class M>
+struct State {
+    char player_to_move = 0;
+
+    State(char player_to_move) : player_to_move(player_to_move) {}
+
+    S &derived() {
+        return static_cast<S&>(*this);
+    }
+
+    const S &derived() const {
+        return static_cast<const S&>(*this);
     }
 
-    virtual string to_executable_format() const {
+    string to_executable_format() const {
         stringstream ss;
         ss << *this;
         return ss.str();
     }
 
-    virtual void swap_players() {}
+    void swap_players() {}
 
-    virtual S clone() const = 0;
-
-    virtual int get_goodness() const = 0;
-
-    virtual vector<M> get_legal_moves(int max_moves) const = 0;
-
-    virtual char get_enemy(char player) const = 0;
+    // Quiet moves may be reduced or pruned by Minimax, tactical ones never are.
+    bool is_quiet(const M &move) const {
+        return true;
+    }
 
-    virtual bool is_terminal() const = 0;
+    // Moves Minimax keeps searching past the depth limit, none by default.
+    vector<M> get_forcing_moves() const {
+        return vector<M>();
+    }
 
-    virtual bool is_winner(char player) const = 0;
+    // Positions an exact solver is worth trying on, none by default.
+    bool is_endgame() const {
+        return false;
+    }
 
-    virtual void make_move(const M &move) = 0;
+    // Cheap guess of a move's worth, higher first, for MCTS progressive widening.
+    // Tactical moves come before quiet ones by default, too coarse to widen on.
+    int score_move(const M &move) const {
+        return derived().is_quiet(move) ? 0 : 1;
+    }
 
-    virtual void undo_move(const M &move) = 0;
+    // A move after which the player to move has won, for the MCTS policies.
+    // Tries every legal move on the state itself and undoes it.
+    bool get_winning_move(M &winning_move) {
+        S &state = derived();
+        const auto current_player = state.player_to_move;
+        for (const M &move : state.get_legal_moves()) {
+            state.make_move(move);
+            const bool winner = state.is_winner(current_player);
+            state.undo_move(move);
+            if (winner) {
+                winning_move = move;
+                return true;
+            }
+        }
+        return false;
+    }
 
-    virtual ostream &to_stream(ostream &os) const = 0;
+    // A move taking away the enemy's immediate win. By default the enemy's winning
+    // move itself, found by handing it the move for a moment.
+    bool get_blocking_move(M &blocking_move) {
+        S &state = derived();
+        const auto current_player = state.player_to_move;
+        state.player_to_move = state.get_enemy(current_player);
+        const bool found = state.get_winning_move(blocking_move);
+        state.player_to_move = current_player;
+        return found;
+    }
 
     friend ostream &operator<<(ostream &os, const State &state) {
-        return state.to_stream(os);
+        return state.derived().to_stream(os);
     }
+};
 
-    virtual bool operator==(const S &other) const = 0;
+// Default Minimax customization points, forwarding to the state.
+// Pass a struct with the same static members to Minimax to replace them.
+template<class S, class M>
+struct StatePolicy {
+    static vector<M> get_legal_moves(const S *state, int max_moves) {
+        return state->get_legal_moves(max_moves);
+    }
 
-    virtual size_t hash() const = 0;
+    static int get_goodness(const S *state) {
+        return state->get_goodness();
+    }
 };
 
 template<class S, class M>
@@ -325,6 +707,170 @@ struct Executable : public Algorithm<S, M> {
     }
 };
 
+// Hands out the moves of one node best first: previous principal variation move,
+// transposition table move, the two killers of the ply, then the rest by history score.
+// Lazy SMP helpers add a thread specific offset below HELPER_ORDER_NOISE to the history
+// scores, so they search the tail in their own order.
+// Selection is lazy, so a node that cuts early never sorts its tail.
+template<class M>
+struct MovePicker {
+    static const int PV_MOVE_SCORE = INF;
+    static const int TT_MOVE_SCORE = INF - 1;
+    static const int KILLER_SCORE = INF - 3;
+
+    struct ScoredMove {
+        int score;
+        int index;
+        PackedMove packed;
+    };
+
+    vector<ScoredMove> order;
+    int next_index = 0;
+
+    MovePicker(const vector<M> &moves, PackedMove pv_move, PackedMove tt_move, const PackedMove *killers, const int *history,
+               int thread_id = 0, int ply = 0) {
+        order.reserve(moves.size());
+        for (int i = 0; i < moves.size(); ++i) {
+            const PackedMove packed = moves[i].pack();
+            int score;
+            if (packed == pv_move) {
+                score = PV_MOVE_SCORE;
+            } else if (packed == tt_move) {
+                score = TT_MOVE_SCORE;
+            } else if (packed == killers[0]) {
+                score = KILLER_SCORE;
+            } else if (packed == killers[1]) {
+                score = KILLER_SCORE - 1;
+            } else {
+                score = history[packed];
+                if (thread_id > 0) {
+                    score += helper_noise(thread_id, ply, packed);
+                }
+            }
+            order.push_back({score, i, packed});
+        }
+    }
+
+    static int helper_noise(int thread_id, int ply, PackedMove packed) {
+        uint64_t x = (uint64_t) thread_id << 32 ^ (uint64_t) ply << 16 ^ packed;
+        x *= 0x9e3779b97f4a7c15;
+        x ^= x >> 32;
+        return x % HELPER_ORDER_NOISE;
+    }
+
+    // Index into the move list of the next move to search, -1 when exhausted
+    int next() {
+        if (next_index >= order.size()) {
+            return -1;
+        }
+        int best = next_index;
+        for (int i = next_index + 1; i < order.size(); ++i) {
+            if (order[best].score < order[i].score) {
+                best = i;
+            }
+        }
+        swap(order[next_index], order[best]);
+        return order[next_index++].index;
+    }
+
+    // Moves already handed out, in search order
+    PackedMove searched(int i) const {
+        return order[i].packed;
+    }
+};
+
+// Counters of one Minimax iteration. The histograms end in a bucket collecting the rest:
+// interior nodes by legal move count (1, 2-3, 4-7, ...), beta cuts by index of the cutting move.
+struct SearchStats {
+    int depth = 0;
+    int goodness = 0;
+    string move;
+    double seconds = 0;
+    long long nodes = 0, leafs = 0, qnodes = 0;
+    long long scout_cuts = 0, researches = 0;
+    long long reductions = 0, futility_prunes = 0;
+    long long beta_cuts = 0, cut_bf_sum = 0;
+    long long tt_hits = 0, tt_exacts = 0, tt_cuts = 0;
+    double tt_fill = 0;
+    long long nps = 0;
+    long long branching[BRANCHING_BUCKETS] = {};
+    long long cut_positions[CUT_POSITION_BUCKETS] = {};
+
+    void count_branching(int moves) {
+        int bucket = 0;
+        while (moves > 1 && bucket < BRANCHING_BUCKETS - 1) {
+            moves >>= 1;
+            ++bucket;
+        }
+        ++branching[bucket];
+    }
+
+    void count_cut(int index) {
+        ++beta_cuts;
+        cut_bf_sum += index + 1;
+        ++cut_positions[min(index, CUT_POSITION_BUCKETS - 1)];
+    }
+
+    double cut_branching_factor() const {
+        return (double) cut_bf_sum / beta_cuts;
+    }
+
+    static void histogram_to_json(ostream &os, const long long *histogram, int size) {
+        os << "[";
+        for (int i = 0; i < size; ++i) {
+            os << (i > 0 ? "," : "") << histogram[i];
+        }
+        os << "]";
+    }
+
+    // Escapes quotes, backslashes and control characters, moves like YinshMove end in a newline
+    static void write_json_string(ostream &os, const string &text) {
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                os << '\\' << c;
+            } else if (c == '\n') {
+                os << "\\n";
+            } else if (c == '\r') {
+                os << "\\r";
+            } else if (c == '\t') {
+                os << "\\t";
+            } else if ((unsigned char) c < 0x20) {
+                os << "\\u00" << "0123456789abcdef"[c >> 4] << "0123456789abcdef"[c & 15];
+            } else {
+                os << c;
+            }
+        }
+    }
+
+    // One line per iteration, for aggregating many games offline
+    void to_json(ostream &os) const {
+        os << "{\"depth\":" << depth
+        << ",\"goodness\":" << goodness
+        << ",\"move\":\"";
+        write_json_string(os, move);
+        os << "\",\"seconds\":" << seconds
+        << ",\"nodes\":" << nodes
+        << ",\"leafs\":" << leafs
+        << ",\"qnodes\":" << qnodes
+        << ",\"scout_cuts\":" << scout_cuts
+        << ",\"researches\":" << researches
+        << ",\"reductions\":" << reductions
+        << ",\"futility_prunes\":" << futility_prunes
+        << ",\"beta_cuts\":" << beta_cuts
+        << ",\"cut_bf\":" << (beta_cuts > 0 ? cut_branching_factor() : 0)
+        << ",\"tt_hits\":" << tt_hits
+        << ",\"tt_exacts\":" << tt_exacts
+        << ",\"tt_cuts\":" << tt_cuts
+        << ",\"tt_fill\":" << tt_fill
+        << ",\"nps\":" << nps
+        << ",\"branching\":";
+        histogram_to_json(os, branching, BRANCHING_BUCKETS);
+        os << ",\"cut_positions\":";
+        histogram_to_json(os, cut_positions, CUT_POSITION_BUCKETS);
+        os << "}\n";
+    }
+};
+
 template<class M>
 struct MinimaxResult {
     int goodness;
@@ -332,108 +878,404 @@ struct MinimaxResult {
     bool completed;
 };
 
-template<class S, class M>
+template<class M>
+struct MultiPVLine {
+    M move;
+    int goodness;
+    vector<M> pv;
+};
+
+template<class S, class M, class P = StatePolicy<S, M>>
 struct Minimax : public Algorithm<S, M> {
-    unordered_map<size_t, TTEntry<M>> transposition_table;
+    shared_ptr<TranspositionTable> transposition_table;
     const double MAX_SECONDS;
     const int MAX_MOVES;
-    function<vector<M>(const S*, int)> get_legal_moves;
-    function<int(const S*)> get_goodness;
-    Timer timer;
-    int scout_cuts;
-    int beta_cuts, cut_bf_sum;
-    int tt_hits, tt_exacts, tt_cuts;
-    int nodes, leafs;
-
-    Minimax(double max_seconds = 1, int max_moves = INF, function<vector<M>(const S*, int)> get_legal_moves = nullptr, function<int(const S*)> get_goodness = nullptr) :
+    const int THREADS;
+    const int MULTI_PV;
+    TimeManager time_manager;
+    int thread_id = 0;
+    shared_ptr<atomic<bool>> stop;
+    long long total_nodes;
+    M root_best_move;
+    bool root_best_found;
+    PackedMove killers[MAX_PLY][2];
+    vector<int> history;
+    vector<M> pv;
+    int pv_length[MAX_PLY];
+    vector<PackedMove> pv_seed;
+    bool on_pv[MAX_PLY] = {};
+    vector<MultiPVLine<M>> multi_pv_lines;
+    // Compared as moves, packed moves may collide
+    vector<M> excluded_root_moves;
+    SearchStats stats;
+    // Completed iterations of the last get_move, main thread only
+    vector<SearchStats> depth_stats;
+    // When set, every completed iteration is also written to it as a JSON line
+    ostream *stats_stream = nullptr;
+
+    Minimax(double max_seconds = 1,
+            int max_moves = INF,
+            size_t tt_megabytes = TT_MEGABYTES,
+            bool tt_huge_pages = false,
+            int threads = 1,
+            int multi_pv = 1) :
             Algorithm<S, M>(),
-            transposition_table(unordered_map<size_t, TTEntry<M>>(1000000)),
+            transposition_table(make_shared<TranspositionTable>(tt_megabytes, tt_huge_pages)),
             MAX_SECONDS(max_seconds),
             MAX_MOVES(max_moves),
-            get_legal_moves(get_legal_moves),
-            get_goodness(get_goodness),
-            timer(Timer()) {}
+            THREADS(max(threads, 1)),
+            MULTI_PV(max(multi_pv, 1)),
+            stop(make_shared<atomic<bool>>(false)),
+            history(HISTORY_SIZE, 0),
+            pv(MAX_PLY * MAX_PLY) {}
+
+    // Lazy SMP helper sharing the transposition table and stop flag of the main search
+    Minimax(const Minimax &main, int thread_id) :
+            Algorithm<S, M>(),
+            transposition_table(main.transposition_table),
+            MAX_SECONDS(main.MAX_SECONDS),
+            MAX_MOVES(main.MAX_MOVES),
+            THREADS(1),
+            MULTI_PV(1),
+            thread_id(thread_id),
+            stop(main.stop),
+            history(HISTORY_SIZE, 0),
+            pv(MAX_PLY * MAX_PLY) {}
+
+    // Entries of earlier searches stay usable, every root search only ages them.
+    // Use clear() to drop them, e.g. between games.
+    void clear() {
+        transposition_table->clear();
+    }
 
-    void reset() {
-        transposition_table.clear();
+    void reset_stats() {
+        stats = SearchStats();
+    }
+
+    // Fills in the per-iteration totals and keeps the iteration
+    void record_stats(int depth, int goodness, const M &move) {
+        stats.depth = depth;
+        stats.goodness = goodness;
+        stringstream stream;
+        stream << move;
+        stats.move = stream.str();
+        stats.seconds = time_manager.seconds_elapsed();
+        stats.tt_fill = transposition_table->fill_rate();
+        stats.nps = (long long) (total_nodes / stats.seconds);
+        depth_stats.push_back(stats);
+        if (stats_stream != nullptr) {
+            stats.to_json(*stats_stream);
+        }
+    }
+
+    // Killers are position specific and start empty, history carries over at half weight.
+    void reset_ordering() {
+        for (auto &ply_killers : killers) {
+            ply_killers[0] = NO_MOVE;
+            ply_killers[1] = NO_MOVE;
+        }
+        for (auto &score : history) {
+            score /= 2;
+        }
+        pv_seed.clear();
+    }
+
+    // Triangular PV table: row ply holds the best line found from that ply on.
+    void update_pv(int ply, const M &move) {
+        M *line = &pv[ply * MAX_PLY];
+        line[ply] = move;
+        pv_length[ply] = ply + 1;
+        if (ply + 1 >= MAX_PLY) {
+            return;
+        }
+        const M *child_line = &pv[(ply + 1) * MAX_PLY];
+        for (int i = ply + 1; i < pv_length[ply + 1]; ++i) {
+            line[i] = child_line[i];
+        }
+        pv_length[ply] = max(pv_length[ply], pv_length[ply + 1]);
+    }
+
+    vector<M> get_pv() const {
+        return vector<M>(pv.begin(), pv.begin() + pv_length[0]);
+    }
+
+    // Next iteration tries the moves of the last principal variation first
+    void seed_pv() {
+        seed_pv(get_pv());
+    }
+
+    void seed_pv(const vector<M> &line) {
+        pv_seed.clear();
+        for (const auto &move : line) {
+            pv_seed.push_back(move.pack());
+        }
+    }
+
+    // History bonus to the move that caused a beta cut-off and a malus to the moves tried before it.
+    // The gravity term keeps every score within [-HISTORY_MAX; HISTORY_MAX].
+    void update_ordering(const MovePicker<M> &picker, int cut_index, int depth, int ply) {
+        const PackedMove cut_move = picker.searched(cut_index);
+        if (ply < MAX_PLY && killers[ply][0] != cut_move) {
+            killers[ply][1] = killers[ply][0];
+            killers[ply][0] = cut_move;
+        }
+        const int bonus = min(depth * depth, HISTORY_MAX);
+        for (int i = 0; i <= cut_index; ++i) {
+            int &score = history[picker.searched(i)];
+            const int delta = i == cut_index ? bonus : -bonus;
+            score += delta - score * bonus / HISTORY_MAX;
+        }
+    }
+
+    // Only the main thread looks at the clock, helpers wait for it to raise the stop flag.
+    bool should_stop() {
+        if (stop->load(memory_order_relaxed)) {
+            return true;
+        }
+        if (thread_id == 0 && time_manager.poll()) {
+            stop->store(true, memory_order_relaxed);
+            return true;
+        }
+        return false;
     }
 
     M get_move(const S *state) override {
+        return get_move(state, MAX_SECONDS);
+    }
+
+    // Same search within a budget other than MAX_SECONDS, for algorithms built on Minimax
+    M get_move(const S *state, double max_seconds) {
         if (state->is_terminal()) {
             stringstream stream;
             state->to_stream(stream);
             throw invalid_argument("Given state is terminal:\n" + stream.str());
         }
-        if (get_legal_moves == nullptr) {
-            get_legal_moves = &State<S,M>::get_legal_moves;
-        }
-        if (get_goodness == nullptr) {
-            get_goodness = &State<S,M>::get_goodness;
-        }
-        timer.start();
-
-        const auto moves = get_legal_moves(state, MAX_MOVES);
+        time_manager.start(max_seconds);
+        transposition_table->new_search();
+        stop->store(false);
+        total_nodes = 0;
+        reset_ordering();
+        multi_pv_lines.clear();
+        depth_stats.clear();
+
+        const auto moves = P::get_legal_moves(state, MAX_MOVES);
         this->log << "moves: " << moves.size() << endl;
         for (const auto move : moves) {
             this->log << move << ", ";
         }
         this->log << endl;
 
+        vector<unique_ptr<Minimax>> helpers;
+        vector<thread> threads;
+        for (int i = 1; i < THREADS; ++i) {
+            helpers.emplace_back(new Minimax(*this, i));
+        }
+        for (auto &helper : helpers) {
+            Minimax *h = helper.get();
+            threads.emplace_back([h, state] { h->search_helper(state); });
+        }
+
         M best_move;
+        int previous_goodness = 0;
         for (int max_depth = 1; max_depth <= MAX_DEPTH; ++max_depth) {
-            scout_cuts = 0;
-            beta_cuts = 0;
-            cut_bf_sum = 0;
-            tt_hits = 0;
-            tt_exacts = 0;
-            tt_cuts = 0;
-            nodes = 0;
-            leafs = 0;
+            if (MULTI_PV > 1) {
+                reset_stats();
+                const bool completed = search_multi_pv(state, max_depth);
+                total_nodes += stats.nodes;
+                if (completed) {
+                    record_stats(max_depth, multi_pv_lines[0].goodness, multi_pv_lines[0].move);
+                    time_manager.iteration_completed(max_depth > 1 && !(multi_pv_lines[0].move == best_move));
+                    best_move = multi_pv_lines[0].move;
+                    for (int k = 0; k < multi_pv_lines.size(); ++k) {
+                        this->log << "multipv: " << k + 1
+                        << " goodness: " << multi_pv_lines[k].goodness
+                        << " time: " << time_manager
+                        << " nodes: " << stats.nodes
+                        << " max_depth: " << max_depth
+                        << " pv: ";
+                        for (const auto &move : multi_pv_lines[k].pv) {
+                            this->log << move << ", ";
+                        }
+                        this->log << endl;
+                    }
+                }
+                if (should_stop() || time_manager.soft_exceeded()) {
+                    break;
+                }
+                continue;
+            }
+            reset_stats();
+            root_best_found = false;
             S clone = state->clone();
-            auto result = minimax(&clone, max_depth, -INF, INF);
+            auto result = search_root(&clone, max_depth, previous_goodness);
+            total_nodes += stats.nodes;
+            if (!result.completed && root_best_found) {
+                // Root moves are searched best first, so a move that beat the
+                // window in the aborted iteration is better than the last result
+                best_move = root_best_move;
+                this->log << "partial move: " << best_move << " max_depth: " << max_depth << endl;
+            }
             if (result.completed) {
+                time_manager.iteration_completed(max_depth > 1 && !(result.best_move == best_move));
                 best_move = result.best_move;
+                previous_goodness = result.goodness;
+                record_stats(max_depth, result.goodness, best_move);
                 this->log << "goodness: " << result.goodness
-                << " time: " << timer
+                << " time: " << time_manager
                 << " move: " << best_move
-                << " nodes: " << nodes
-                << " leafs: " << leafs
-                << " scout_cuts: " << scout_cuts
-                << " beta_cuts: " << beta_cuts
-                << " cutBF: " << (double) cut_bf_sum / beta_cuts
-                << " tt_hits: " << tt_hits
-                << " tt_exacts: " << tt_exacts
-                << " tt_cuts: " << tt_cuts
-                << " tt_size: " << transposition_table.size()
+                << " nodes: " << stats.nodes
+                << " leafs: " << stats.leafs
+                << " qnodes: " << stats.qnodes
+                << " scout_cuts: " << stats.scout_cuts
+                << " researches: " << stats.researches
+                << " lmr: " << stats.reductions
+                << " futility: " << stats.futility_prunes
+                << " beta_cuts: " << stats.beta_cuts
+                << " cutBF: " << stats.cut_branching_factor()
+                << " tt_hits: " << stats.tt_hits
+                << " tt_exacts: " << stats.tt_exacts
+                << " tt_cuts: " << stats.tt_cuts
+                << " tt_fill: " << stats.tt_fill
+                << " nps: " << stats.nps
                 << " max_depth: " << max_depth << endl;
+                this->log << "pv: ";
+                for (const auto &move : get_pv()) {
+                    this->log << move << ", ";
+                }
+                this->log << endl;
+                seed_pv();
             }
-            if (timer.exceeded(MAX_SECONDS)) {
+            if (should_stop() || time_manager.soft_exceeded()) {
                 break;
             }
         }
+
+        stop->store(true);
+        for (auto &t : threads) {
+            t.join();
+        }
+        if (THREADS > 1) {
+            this->log << "thread 0 nodes: " << total_nodes << endl;
+            for (const auto &helper : helpers) {
+                this->log << "thread " << helper->thread_id << " nodes: " << helper->total_nodes << endl;
+            }
+        }
         return best_move;
     }
 
+    // Same iterative deepening as the main thread on a private clone,
+    // with results shared only through the transposition table.
+    void search_helper(const S *state) {
+        total_nodes = 0;
+        reset_ordering();
+        const int i = (thread_id - 1) % 20;
+        int previous_goodness = 0;
+        for (int max_depth = 1; max_depth <= MAX_DEPTH; ++max_depth) {
+            if (((max_depth + SKIP_PHASE[i]) / SKIP_SIZE[i]) % 2) {
+                continue;
+            }
+            reset_stats();
+            S clone = state->clone();
+            const auto result = aspiration_search(&clone, max_depth, previous_goodness);
+            total_nodes += stats.nodes;
+            if (result.completed) {
+                previous_goodness = result.goodness;
+                seed_pv();
+            }
+            if (should_stop()) {
+                break;
+            }
+        }
+    }
+
+    // Multi-PV: the root is searched once per line, excluding the root moves of the lines
+    // found before. All lines share the transposition table, so later lines mostly
+    // re-read what the first one stored. False when time ran out, keeping the last lines.
+    bool search_multi_pv(const S *state, int depth) {
+        vector<MultiPVLine<M>> lines;
+        const int line_count = min<int>(MULTI_PV, P::get_legal_moves(state, MAX_MOVES).size());
+        excluded_root_moves.clear();
+        for (int k = 0; k < line_count; ++k) {
+            const bool has_previous = k < multi_pv_lines.size();
+            seed_pv(has_previous ? multi_pv_lines[k].pv : vector<M>());
+            S clone = state->clone();
+            const auto result = search_root(&clone, depth, has_previous ? multi_pv_lines[k].goodness : 0);
+            if (!result.completed) {
+                excluded_root_moves.clear();
+                return false;
+            }
+            lines.push_back({result.best_move, result.goodness, get_pv()});
+            excluded_root_moves.push_back(result.best_move);
+        }
+        excluded_root_moves.clear();
+        multi_pv_lines = lines;
+        return true;
+    }
+
+    // One iteration of the main thread, helpers always use aspiration_search.
+    virtual MinimaxResult<M> search_root(S *state, int depth, int previous_goodness) {
+        return aspiration_search(state, depth, previous_goodness);
+    }
+
+    // Searches the root with a window centered on the previous iteration's goodness,
+    // doubling the window on the failing side until the value falls inside it.
+    MinimaxResult<M> aspiration_search(S *state, int depth, int previous_goodness) {
+        if (depth < ASPIRATION_MIN_DEPTH) {
+            return minimax(state, depth, -INF, INF);
+        }
+        long long delta = ASPIRATION_DELTA;
+        long long alpha = max<long long>(previous_goodness - delta, -INF);
+        long long beta = min<long long>(previous_goodness + delta, INF);
+        while (true) {
+            const auto result = minimax(state, depth, alpha, beta);
+            if (!result.completed) {
+                return result;
+            }
+            if (result.goodness <= alpha && alpha > -INF) {
+                beta = (alpha + beta) / 2;
+                alpha = max<long long>(result.goodness - delta, -INF);
+            } else if (result.goodness >= beta && beta < INF) {
+                beta = min<long long>(result.goodness + delta, INF);
+            } else {
+                return result;
+            }
+            ++stats.researches;
+            delta *= 2;
+        }
+    }
+
     // Find Minimax value of the given tree,
     // Minimax value lies within a range of [alpha; beta] window.
     // Whenever alpha >= beta, further checks of children in a node can be pruned.
-    MinimaxResult<M> minimax(S *state, int depth, int alpha, int beta) {
-        ++nodes;
+    // The transposition table only stores packed moves, so it never cuts at the root (ply 0),
+    // nor in PV nodes (open window) where a cut-off would truncate the principal variation.
+    MinimaxResult<M> minimax(S *state, int depth, int alpha, int beta, int ply = 0) {
+        ++stats.nodes;
         const int alpha_original = alpha;
+        pv_length[ply] = ply;
+        if (ply == 0) {
+            on_pv[0] = true;
+        }
 
         M best_move;
-        if (depth == 0 || state->is_terminal()) {
-            ++leafs;
-            return {get_goodness(state), best_move, false};
+        if (state->is_terminal()) {
+            ++stats.leafs;
+            return {P::get_goodness(state), best_move, false};
+        }
+        if (depth == 0) {
+            ++stats.leafs;
+            return {quiesce(state, alpha, beta, ply, 0), best_move, false};
         }
 
-        TTEntry<M> entry;
-        const bool entry_found = get_tt_entry(state, entry);
-        if (entry_found && entry.depth >= depth) {
-            ++tt_hits;
+        const size_t key = state->hash();
+        TTEntry entry;
+        const bool entry_found = get_tt_entry(key, entry);
+        const bool pv_node = (long long) beta - alpha > 1;
+        if (entry_found && entry.depth >= depth && ply > 0 && !pv_node) {
+            ++stats.tt_hits;
             if (entry.value_type == TTEntryType::EXACT_VALUE) {
-                ++tt_exacts;
-                return {entry.value, entry.move, true};
+                ++stats.tt_exacts;
+                return {entry.value, best_move, true};
             }
             if (entry.value_type == TTEntryType::LOWER_BOUND && alpha < entry.value) {
                 alpha = entry.value;
@@ -442,59 +1284,95 @@ struct Minimax : public Algorithm<S, M> {
                 beta = entry.value;
             }
             if (alpha >= beta) {
-                ++tt_cuts;
-                return {entry.value, entry.move, true};
+                ++stats.tt_cuts;
+                return {entry.value, best_move, true};
             }
         }
 
         int max_goodness = -INF;
+        PackedMove best_packed = NO_MOVE;
 
         bool completed = true;
-        const auto legal_moves = get_legal_moves(state, MAX_MOVES);
+        auto legal_moves = P::get_legal_moves(state, MAX_MOVES);
+        if (ply == 0 && !excluded_root_moves.empty()) {
+            legal_moves.erase(remove_if(legal_moves.begin(), legal_moves.end(), [this](const M &move) {
+                return find(excluded_root_moves.begin(), excluded_root_moves.end(), move) != excluded_root_moves.end();
+            }), legal_moves.end());
+        }
         assert(legal_moves.size() > 0);
-        for (int i = 0; i < legal_moves.size(); i++) {
-            const auto move = legal_moves[i];
+        stats.count_branching(legal_moves.size());
+        const PackedMove pv_move = on_pv[ply] && ply < pv_seed.size() ? pv_seed[ply] : NO_MOVE;
+        MovePicker<M> picker(
+            legal_moves,
+            pv_move,
+            entry_found ? entry.move : NO_MOVE,
+            killers[min(ply, MAX_PLY - 1)],
+            history.data(),
+            thread_id,
+            ply
+        );
+        // Frontier nodes compare the static goodness plus a margin against alpha.
+        // PV nodes have exact bounds, they neither prune nor reduce.
+        const bool futility_node = ply > 0 && !pv_node && depth <= FUTILITY_MAX_DEPTH;
+        const long long futility_goodness = futility_node ? (long long) P::get_goodness(state) + FUTILITY_MARGIN * depth : INF;
+        int index;
+        for (int i = 0; (index = picker.next()) >= 0; i++) {
+            const auto &move = legal_moves[index];
+            const bool quiet = i > 0 && ply > 0 && state->is_quiet(move);
+            if (quiet && futility_goodness <= alpha) {
+                ++stats.futility_prunes;
+                max_goodness = max<long long>(max_goodness, futility_goodness);
+                continue;
+            }
+            on_pv[ply + 1] = pv_move != NO_MOVE && picker.searched(i) == pv_move;
+            const char player = state->player_to_move;
             state->make_move(move);
+            const bool passed = state->player_to_move != player;
+            if (depth > 1) {
+                transposition_table->prefetch(state->hash());
+            }
             int goodness;
             if (i > 0) {
-                // null window search
-                goodness = -minimax(
-                    state,
-                    depth - 1,
-                    -alpha - 1,
-                    -alpha
-                ).goodness;
+                int reduction = 0;
+                if (quiet && !pv_node && depth >= LMR_MIN_DEPTH && i >= LMR_MIN_MOVES) {
+                    reduction = (depth >= 6 && i >= 3 * LMR_MIN_MOVES) ? 2 : 1;
+                    ++stats.reductions;
+                }
+                // null window search, reduced for late quiet moves
+                goodness = search_child(state, passed, depth - 1 - reduction, alpha, alpha + 1, ply + 1);
+                if (reduction > 0 && goodness > alpha) {
+                    // reduced search beat alpha, verify at full depth
+                    goodness = search_child(state, passed, depth - 1, alpha, alpha + 1, ply + 1);
+                }
                 if (alpha < goodness && goodness < beta) {
-                    // failed high, do a full re-search
-                    goodness = -minimax(
-                        state,
-                        depth - 1,
-                        -beta,
-                        -goodness
-                    ).goodness;
+                    // failed high, re-search with the full window so the child stays a PV node
+                    goodness = search_child(state, passed, depth - 1, alpha, beta, ply + 1);
                 } else {
-                    scout_cuts++;
+                    stats.scout_cuts++;
                 }
             }
             else {
-                goodness = -minimax(
-                    state,
-                    depth - 1,
-                    -beta,
-                    -alpha
-                ).goodness;
+                goodness = search_child(state, passed, depth - 1, alpha, beta, ply + 1);
             }
             state->undo_move(move);
-            if (timer.exceeded(MAX_SECONDS)) {
+            if (should_stop()) {
                 completed = false;
                 break;
             }
             if (max_goodness < goodness) {
                 max_goodness = goodness;
                 best_move = move;
+                best_packed = picker.searched(i);
+                if (goodness > alpha) {
+                    update_pv(ply, move);
+                }
+                if (ply == 0 && goodness > alpha) {
+                    root_best_move = move;
+                    root_best_found = true;
+                }
                 if (max_goodness >= beta) {
-                    ++beta_cuts;
-                    cut_bf_sum += i + 1;
+                    stats.count_cut(i);
+                    update_ordering(picker, i, depth, ply);
                     break;
                 }
             }
@@ -503,29 +1381,64 @@ struct Minimax : public Algorithm<S, M> {
             }
         }
 
-        if (completed) {
-            update_tt(state, alpha_original, beta, max_goodness, best_move, depth);
+        // With excluded root moves the value is not the root's, keep it out of the table
+        if (completed && (ply > 0 || excluded_root_moves.empty())) {
+            update_tt(key, alpha_original, beta, max_goodness, best_packed, depth);
         }
 
         return {max_goodness, best_move, completed};
     }
 
-    bool get_tt_entry(const S *state, TTEntry<M> &entry) const {
-        const auto key = state->hash();
-        const auto it = transposition_table.find(key);
-        if (it == transposition_table.end()) {
-            return false;
+    // Value after a move from the view of the player who made it, within [alpha; beta].
+    // The window and the value are negated only if the move passed the turn,
+    // e.g. a Yinsh row removal keeps the same player to move.
+    int search_child(S *state, bool passed, int depth, int alpha, int beta, int ply) {
+        if (!passed) {
+            return minimax(state, depth, alpha, beta, ply).goodness;
         }
-        entry = it->second;
-        return true;
+        return -minimax(state, depth, -beta, -alpha, ply).goodness;
     }
 
-    void add_tt_entry(const S *state, const TTEntry<M> &entry) {
-        const auto key = state->hash();
-        transposition_table.insert({key, entry});
+    // Extends a leaf along forcing moves only (see State::get_forcing_moves),
+    // the side to move may always stand pat on the static goodness instead.
+    int quiesce(S *state, int alpha, int beta, int ply, int qdepth) {
+        const int stand_pat = P::get_goodness(state);
+        if (stand_pat >= beta || qdepth >= MAX_QUIESCENCE_DEPTH || ply >= MAX_PLY - 1 || state->is_terminal()) {
+            return stand_pat;
+        }
+        if (alpha < stand_pat) {
+            alpha = stand_pat;
+        }
+        int max_goodness = stand_pat;
+        for (const auto &move : state->get_forcing_moves()) {
+            const char player = state->player_to_move;
+            state->make_move(move);
+            ++stats.qnodes;
+            const int goodness = state->player_to_move != player
+                                 ? -quiesce(state, -beta, -alpha, ply + 1, qdepth + 1)
+                                 : quiesce(state, alpha, beta, ply + 1, qdepth + 1);
+            state->undo_move(move);
+            if (should_stop()) {
+                break;
+            }
+            if (max_goodness < goodness) {
+                max_goodness = goodness;
+                if (max_goodness >= beta) {
+                    break;
+                }
+                if (alpha < max_goodness) {
+                    alpha = max_goodness;
+                }
+            }
+        }
+        return max_goodness;
+    }
+
+    bool get_tt_entry(size_t key, TTEntry &entry) {
+        return transposition_table->probe(key, entry);
     }
 
-    void update_tt(const S *state, int alpha, int beta, int max_goodness, const M &best_move, int depth) {
+    void update_tt(size_t key, int alpha, int beta, int max_goodness, PackedMove best_move, int depth) {
         TTEntryType value_type;
         if (max_goodness <= alpha) {
             value_type = TTEntryType::UPPER_BOUND;
@@ -536,8 +1449,7 @@ struct Minimax : public Algorithm<S, M> {
         else {
             value_type = TTEntryType::EXACT_VALUE;
         }
-        const TTEntry<M> entry = {best_move, depth, max_goodness, value_type};
-        add_tt_entry(state, entry);
+        transposition_table->store(key, best_move, depth, max_goodness, value_type);
     }
 
     string get_name() const {
@@ -545,216 +1457,789 @@ struct Minimax : public Algorithm<S, M> {
     }
 };
 
+// MTD(f): the root is searched with null windows only, converging on the value
+// from the previous iteration's goodness as the first guess.
+// Each pass after the first counts as a research in the log.
+template<class S, class M, class P = StatePolicy<S, M>>
+struct MTDf : public Minimax<S, M, P> {
+
+    MTDf(double max_seconds = 1,
+         int max_moves = INF,
+         size_t tt_megabytes = TT_MEGABYTES,
+         bool tt_huge_pages = false,
+         int threads = 1) :
+            Minimax<S, M, P>(max_seconds, max_moves, tt_megabytes, tt_huge_pages, threads) {}
+
+    MinimaxResult<M> search_root(S *state, int depth, int previous_goodness) override {
+        int lower = -INF;
+        int upper = INF;
+        int guess = previous_goodness;
+        M best_move;
+        bool best_found = false;
+        bool first_pass = true;
+        while (lower < upper) {
+            const int beta = guess == lower ? guess + 1 : guess;
+            const auto result = this->minimax(state, depth, beta - 1, beta);
+            if (!result.completed) {
+                return result;
+            }
+            if (!first_pass) {
+                ++this->stats.researches;
+            }
+            first_pass = false;
+            guess = result.goodness;
+            if (guess < beta) {
+                upper = guess;
+            } else {
+                lower = guess;
+                // Only a fail high proves its move reaches the bound
+                best_move = result.best_move;
+                best_found = true;
+            }
+            if (!best_found) {
+                best_move = result.best_move;
+            }
+        }
+        return {guess, best_move, true};
+    }
+
+    string get_name() const {
+        return "MTDf";
+    }
+};
+
+static const int MCTS_UNEXPANDED = -1;
+static const int MCTS_EXPANDING = -2;
+
+// Tree node of MonteCarloTreeSearch. Children of a node are one contiguous block
+// of the arena, child i belongs to the i-th legal move of the node's state.
+// Nodes hold no state, it is rebuilt by replaying the moves from the root.
+// Statistics are atomic so that threads can share the tree.
+struct MCTSNode {
+    atomic<double> score;
+    atomic<unsigned> visits;
+    // All moves as first: results of simulations playing this move later on, by the same player
+    atomic<double> amaf_score;
+    atomic<unsigned> amaf_visits;
+    int parent = -1;
+    // Published with release once child_count and the children are written
+    atomic<int> first_child;
+    int child_count = 0;
+    PackedMove move = NO_MOVE;
+    // Position among its siblings by State::score_move, children are admitted in this order
+    int rank = 0;
+
+    MCTSNode() : score(0), visits(0), amaf_score(0), amaf_visits(0), first_child(MCTS_UNEXPANDED) {}
+
+    MCTSNode(const MCTSNode &node) : MCTSNode() {
+        *this = node;
+    }
+
+    // Only used while no other thread touches either node
+    MCTSNode &operator=(const MCTSNode &node) {
+        score.store(node.score.load(memory_order_relaxed), memory_order_relaxed);
+        visits.store(node.visits.load(memory_order_relaxed), memory_order_relaxed);
+        amaf_score.store(node.amaf_score.load(memory_order_relaxed), memory_order_relaxed);
+        amaf_visits.store(node.amaf_visits.load(memory_order_relaxed), memory_order_relaxed);
+        parent = node.parent;
+        first_child.store(node.first_child.load(memory_order_relaxed), memory_order_relaxed);
+        child_count = node.child_count;
+        move = node.move;
+        rank = node.rank;
+        return *this;
+    }
+
+    static void add(atomic<double> &value, double delta) {
+        double expected = value.load(memory_order_relaxed);
+        while (!value.compare_exchange_weak(expected, expected + delta, memory_order_relaxed)) {}
+    }
+
+    void add_score(double delta) {
+        add(score, delta);
+    }
+
+    void add_amaf(double result) {
+        add(amaf_score, result);
+        amaf_visits.fetch_add(1, memory_order_relaxed);
+    }
+};
+
+// Allocated by bumping an atomic counter, so threads can allocate concurrently and
+// indices stay valid. Memory comes in blocks of 2^ARENA_BLOCK_BITS items, allocated when
+// first used, so the capacity only bounds the growth. Freed in O(1) by forgetting how much
+// is used, the blocks are kept for the next tree until release().
+template<class T>
+struct Arena {
+    static const int BLOCK_MASK = (1 << ARENA_BLOCK_BITS) - 1;
+
+    unique_ptr<atomic<T*>[]> blocks;
+    int capacity = 0;
+    atomic<int> used;
+
+    Arena() : used(0) {}
+
+    Arena(const Arena&) = delete;
+
+    Arena &operator=(const Arena&) = delete;
+
+    ~Arena() {
+        release();
+    }
+
+    int block_count() const {
+        return (capacity + BLOCK_MASK) >> ARENA_BLOCK_BITS;
+    }
+
+    void reserve(int new_capacity) {
+        if (capacity != new_capacity) {
+            release();
+            capacity = new_capacity;
+            blocks.reset(new atomic<T*>[block_count()]);
+            for (int i = 0; i < block_count(); ++i) {
+                blocks[i].store(nullptr, memory_order_relaxed);
+            }
+        }
+        used = 0;
+    }
+
+    // Frees the blocks, the capacity stays
+    void release() {
+        for (int i = 0; i < block_count(); ++i) {
+            delete[] blocks[i].exchange(nullptr, memory_order_relaxed);
+        }
+        used = 0;
+    }
+
+    // First index of count contiguous, value-initialized items, -1 when they do not fit.
+    // used never passes the capacity, so failed attempts can repeat forever.
+    int allocate(int count) {
+        int first = used.load(memory_order_relaxed);
+        do {
+            if (count > capacity - first) {
+                return -1;
+            }
+        } while (!used.compare_exchange_weak(first, first + count, memory_order_relaxed));
+        for (int block = first >> ARENA_BLOCK_BITS; block <= (first + count - 1) >> ARENA_BLOCK_BITS; ++block) {
+            add_block(block);
+        }
+        for (int i = first; i < first + count; ++i) {
+            (*this)[i] = T();
+        }
+        return first;
+    }
+
+    // Threads racing for the same block keep the first one installed
+    void add_block(int block) {
+        if (blocks[block].load(memory_order_acquire) != nullptr) {
+            return;
+        }
+        T *fresh = new T[1 << ARENA_BLOCK_BITS];
+        T *expected = nullptr;
+        if (!blocks[block].compare_exchange_strong(expected, fresh, memory_order_acq_rel)) {
+            delete[] fresh;
+        }
+    }
+
+    void reset() {
+        used = 0;
+    }
+
+    int size() const {
+        return used.load(memory_order_relaxed);
+    }
+
+    // Bytes of the blocks allocated so far
+    size_t allocated_bytes() const {
+        size_t bytes = 0;
+        for (int i = 0; i < block_count(); ++i) {
+            if (blocks[i].load(memory_order_relaxed) != nullptr) {
+                bytes += sizeof(T) << ARENA_BLOCK_BITS;
+            }
+        }
+        return bytes;
+    }
+
+    void swap(Arena &other) {
+        blocks.swap(other.blocks);
+        std::swap(capacity, other.capacity);
+        const int other_used = other.used;
+        other.used = used.load();
+        used = other_used;
+    }
+
+    T &operator[](int index) {
+        return blocks[index >> ARENA_BLOCK_BITS].load(memory_order_acquire)[index & BLOCK_MASK];
+    }
+
+    const T &operator[](int index) const {
+        return blocks[index >> ARENA_BLOCK_BITS].load(memory_order_acquire)[index & BLOCK_MASK];
+    }
+};
+
+// Everything one MCTS thread keeps to itself
+template<class S, class M>
+struct MCTSWorker {
+    // Working copy of the root, back at the root after every simulation
+    S state;
+    // Made on the way down, undone after the simulation
+    vector<M> moves;
+    // Nodes given a virtual loss on the way down, with the score it added
+    vector<int> path;
+    vector<double> virtual_scores;
+    // Rollout moves, every worker draws from its own generator
+    Random random;
+    // Every move of the simulation, in the tree and in the rollout, and whether the root player made it
+    vector<pair<PackedMove, bool>> played;
+    // seen[by_root][move] == stamp marks moves played from the current point of the simulation on
+    vector<unsigned> seen[2];
+    unsigned stamp = 0;
+    int simulations = 0;
+
+    MCTSWorker(const S *root, const Random &random) : state(root->clone()), random(random) {}
+};
+
 template<class S, class M>
 struct MonteCarloTreeSearch : public Algorithm<S, M> {
     const double max_seconds;
     const int max_simulations;
     const bool block;
-    const Random random;
+    const int threads;
+    // Bound on the tree size, memory is only allocated as the tree grows
+    const int max_nodes;
+    // Every search and worker gets its own stream of the seed
+    const unsigned seed;
+    Random streams;
+    // Visits at which UCT trusts a child's own value as much as its AMAF value, 0 (the default) turns RAVE off
+    const double rave_equivalence;
+    // A node with n visits admits ceil(k * n^alpha) children, k = 0 (the default) admits all of them
+    const double widening_k;
+    const double widening_alpha;
+    Arena<MCTSNode> nodes;
+    // Compaction target when the tree is reused, swapped with nodes afterwards
+    Arena<MCTSNode> spare_nodes;
+    // Position at node 0, kept so the next get_move can find its own position in the tree
+    unique_ptr<S> tree_root;
+    int simulations = 0;
 
     MonteCarloTreeSearch(double max_seconds = 1,
                          int max_simulations = MAX_SIMULATIONS,
-                         bool block = false) :
+                         bool block = false,
+                         int threads = 1,
+                         int max_nodes = MCTS_MAX_NODES,
+                         unsigned seed = 0,
+                         double rave_equivalence = MCTS_RAVE_EQUIVALENCE,
+                         double widening_k = MCTS_WIDENING_K,
+                         double widening_alpha = MCTS_WIDENING_ALPHA) :
         Algorithm<S, M>(),
         max_seconds(max_seconds),
+        max_simulations(max_simulations),
         block(block),
-        max_simulations(max_simulations) {}
+        threads(max(threads, 1)),
+        max_nodes(max_nodes),
+        seed(seed),
+        streams(seed),
+        rave_equivalence(rave_equivalence),
+        widening_k(widening_k),
+        widening_alpha(widening_alpha) {}
 
     M get_move(const S *root) override {
+        search(root);
+        const auto legal_moves = root->get_legal_moves();
+        this->log << "moves: " << legal_moves.size() << endl;
+        for (int i = 0; i < (int) legal_moves.size(); ++i) {
+            this->log << "move: " << legal_moves[i];
+            if (nodes[0].first_child >= 0 && nodes[nodes[0].first_child + i].visits > 0) {
+                const int child = nodes[0].first_child + i;
+                this->log << " score: " << nodes[child].score.load()
+                << " visits: " << nodes[child].visits.load()
+                << " amaf_score: " << nodes[child].amaf_score.load()
+                << " amaf_visits: " << nodes[child].amaf_visits.load()
+                << " UCT: " << get_uct(child, UCT_C);
+            }
+            this->log << endl;
+        }
+        const int best = get_most_visited_child(0);
+        if (best < 0) {
+            // No simulation ran or the arena could not hold the root's children
+            S state = root->clone();
+            return get_default_policy_move(&state, streams);
+        }
+        return legal_moves[best];
+    }
+
+    // Grows the tree under root until time or simulations run out.
+    // Threads share the tree, each descends on its own copy of the root.
+    void search(const S *root) {
         if (root->is_terminal()) {
             stringstream stream;
             root->to_stream(stream);
             throw invalid_argument("Given state is terminal:\n" + stream.str());
         }
-        Timer timer;
-        timer.start();
-        int simulation = 0;
-        S clone = root->clone();
-        while (simulation < max_simulations && !timer.exceeded(max_seconds)) {
-            monte_carlo_tree_search(&clone);
-            ++simulation;
+        TimeManager time_manager(MCTS_POLL_INTERVAL);
+        time_manager.start(max_seconds);
+        const int reused = tree_root != nullptr ? find_node(tree_root.get(), 0, root, 0) : -1;
+        if (reused >= 0) {
+            promote(reused);
+        } else {
+            nodes.reserve(max_nodes);
+            nodes.allocate(1);
         }
-        this->log << "ratio: " << root->score / root->visits << endl;
-        this->log << "simulations: " << simulation << endl;
-        const auto legal_moves = root->get_legal_moves();
-        this->log << "moves: " << legal_moves.size() << endl;
-        for (const auto move : legal_moves) {
-            this->log << "move: " << move;
-            const auto child = root->get_child(move);
-            if (child != nullptr) {
-                this->log << " score: " << child->score
-                << " visits: " << child->visits
-                << " UCT: " << child->get_uct(UCT_C);
+        tree_root.reset(new S(root->clone()));
+        this->log << "reused visits: " << nodes[0].visits.load() << " nodes: " << nodes.size() << endl;
+
+        vector<unique_ptr<MCTSWorker<S, M>>> workers;
+        for (int i = 0; i < threads; ++i) {
+            streams.jump();
+            workers.emplace_back(new MCTSWorker<S, M>(root, streams));
+        }
+        atomic<bool> stop(false);
+        atomic<int> started(0);
+        const auto work = [this, root, &stop, &started](MCTSWorker<S, M> *worker, TimeManager *time_manager) {
+            while (!stop.load(memory_order_relaxed) && started.fetch_add(1, memory_order_relaxed) < max_simulations) {
+                monte_carlo_tree_search(worker, root);
+                ++worker->simulations;
+                if (time_manager != nullptr && time_manager->poll()) {
+                    stop.store(true, memory_order_relaxed);
+                }
+            }
+        };
+        vector<thread> helpers;
+        for (int i = 1; i < threads; ++i) {
+            helpers.emplace_back(work, workers[i].get(), nullptr);
+        }
+        work(workers[0].get(), &time_manager);
+        stop.store(true);
+        for (auto &helper : helpers) {
+            helper.join();
+        }
+
+        simulations = 0;
+        for (const auto &worker : workers) {
+            simulations += worker->simulations;
+        }
+        this->log << "ratio: " << nodes[0].score / nodes[0].visits << endl;
+        this->log << "simulations: " << simulations << endl;
+        if (threads > 1) {
+            for (int i = 0; i < threads; ++i) {
+                this->log << "thread " << i << " simulations: " << workers[i]->simulations << endl;
             }
-            this->log << endl;
         }
-        return get_most_visited_move(&clone);
+        this->log << "nodes: " << nodes.size() << " bytes: " << nodes.allocated_bytes() << endl;
     }
 
-    void monte_carlo_tree_search(S *root) const {
-        S *current = tree_policy(root, root);
-        const auto result = rollout(current, root);
-        propagate_up(current, result);
+    // Visits of the child of the root for the i-th legal move, 0 if not expanded
+    unsigned get_root_visits(int i) const {
+        const int first_child = nodes[0].first_child.load();
+        return first_child >= 0 ? nodes[first_child + i].visits.load() : 0;
     }
 
-    void propagate_up(S *current, double result) const {
-        current->update_stats(result);
-        if (current->parent) {
-            propagate_up(current->parent, result);
+    // Drops the tree, e.g. between games. reset() keeps it for reuse on the next move.
+    void clear() {
+        tree_root.reset();
+        nodes.reset();
+    }
+
+    // Node below index holding the wanted position, at most MCTS_REUSE_MAX_PLIES deep, or -1.
+    // Scores are from the tree root player's view, so only nodes with that player to move match.
+    int find_node(const S *state, int index, const S *wanted, int plies) const {
+        if (state->player_to_move == tree_root->player_to_move &&
+            state->hash() == wanted->hash() && *state == *wanted) {
+            return index;
+        }
+        const MCTSNode &node = nodes[index];
+        if (plies == MCTS_REUSE_MAX_PLIES || node.first_child < 0) {
+            return -1;
+        }
+        const auto legal_moves = state->get_legal_moves();
+        for (int i = 0; i < node.child_count; ++i) {
+            if (nodes[node.first_child + i].visits == 0) {
+                continue;
+            }
+            S child = state->clone();
+            child.make_move(legal_moves[i]);
+            const int found = find_node(&child, node.first_child + i, wanted, plies + 1);
+            if (found >= 0) {
+                return found;
+            }
         }
+        return -1;
     }
 
-    S* tree_policy(S *state, const S *root) const {
-        if (state->is_terminal()) {
-            return state;
+    // Copies the subtree under index into the spare arena breadth first, keeping every
+    // child block contiguous, and makes it the tree. Everything else is freed with it.
+    void promote(int index) {
+        spare_nodes.reserve(max_nodes);
+        spare_nodes.allocate(1);
+        spare_nodes[0] = nodes[index];
+        spare_nodes[0].parent = -1;
+        spare_nodes[0].move = NO_MOVE;
+        for (int copied = 0; copied < spare_nodes.size(); ++copied) {
+            const int old_first_child = spare_nodes[copied].first_child;
+            if (old_first_child < 0) {
+                continue;
+            }
+            const int count = spare_nodes[copied].child_count;
+            const int first_child = spare_nodes.allocate(count);
+            for (int i = 0; i < count; ++i) {
+                spare_nodes[first_child + i] = nodes[old_first_child + i];
+                spare_nodes[first_child + i].parent = copied;
+            }
+            spare_nodes[copied].first_child = first_child;
+        }
+        nodes.swap(spare_nodes);
+        // The old tree's blocks would double the memory until the next reuse
+        spare_nodes.release();
+    }
+
+    // Leaves the worker's state as it was, all moves made on the way down are undone
+    void monte_carlo_tree_search(MCTSWorker<S, M> *worker, const S *root) {
+        worker->moves.clear();
+        worker->path.clear();
+        worker->virtual_scores.clear();
+        worker->played.clear();
+        tree_policy(worker, root);
+        const auto result = rollout(&worker->state, root, worker);
+        propagate_up(worker, result);
+        if (rave_equivalence > 0) {
+            update_amaf(worker, result);
         }
-        const M move = get_tree_policy_move(state, root);
-        const auto child = state->get_child(move);
-        if (child == nullptr) {
-            return state->add_child(move);
+        for (auto move = worker->moves.rbegin(); move != worker->moves.rend(); ++move) {
+            worker->state.undo_move(*move);
         }
-        return tree_policy(child, root);
     }
 
-    M get_most_visited_move(const S *state) const {
-        const auto legal_moves = state->get_legal_moves();
-        assert(legal_moves.size() > 0);
-        M best_move;
-        double max_visits = -INF;
-        for (const auto move : legal_moves) {
-            const auto child = state->get_child(move);
-            if (child != nullptr) {
-                const auto visits = child->visits;
-                if (max_visits < visits) {
-                    max_visits = visits;
-                    best_move = move;
+    // Visits were counted on the way down, only the virtual scores are replaced by the result
+    void propagate_up(MCTSWorker<S, M> *worker, double result) {
+        for (int k = 0; k < (int) worker->path.size(); ++k) {
+            nodes[worker->path[k]].add_score(result - worker->virtual_scores[k]);
+        }
+        nodes[0].visits.fetch_add(1, memory_order_relaxed);
+        nodes[0].add_score(result);
+    }
+
+    // Walks the simulation backwards. The node where the j-th move was made credits each
+    // child whose move the same player made at step j or later.
+    void update_amaf(MCTSWorker<S, M> *worker, double result) {
+        if (worker->seen[0].empty() || ++worker->stamp == 0) {
+            for (auto &seen : worker->seen) {
+                seen.assign(1 << 16, 0);
+            }
+            worker->stamp = 1;
+        }
+        const int tree_moves = worker->path.size();
+        for (int j = (int) worker->played.size() - 1; j >= 0; --j) {
+            const PackedMove move = worker->played[j].first;
+            const bool by_root = worker->played[j].second;
+            vector<unsigned> &seen = worker->seen[by_root];
+            seen[move] = worker->stamp;
+            if (j > tree_moves) {
+                continue;
+            }
+            const MCTSNode &node = nodes[j == 0 ? 0 : worker->path[j - 1]];
+            const int first_child = node.first_child.load(memory_order_acquire);
+            if (first_child < 0) {
+                continue;
+            }
+            for (int i = first_child; i < first_child + node.child_count; ++i) {
+                if (seen[nodes[i].move] == worker->stamp) {
+                    nodes[i].add_amaf(result);
                 }
             }
         }
-        assert(max_visits != -INF);
-        return best_move;
     }
 
-    M get_best_move(S *state, const S *root) const {
-        const auto legal_moves = state->get_legal_moves();
-        assert(legal_moves.size() > 0);
-        M best_move;
-        if (state->player_to_move == root->player_to_move) {
-            // maximize
-            double best_uct = -INF;
-            for (const auto move : legal_moves) {
-                const auto child = state->get_child(move);
-                if (child != nullptr) {
-                    const auto uct = child->get_uct(UCT_C);
-                    if (best_uct < uct) {
-                        best_uct = uct;
-                        best_move = move;
-                    }
-                } else {
-                    return move;
-                }
+    double get_uct(int index, double c) const {
+        const MCTSNode &node = nodes[index];
+        const unsigned visits = node.visits.load(memory_order_relaxed);
+        assert(visits > 0);
+        double parent_visits = 0.0;
+        if (node.parent >= 0) {
+            parent_visits = nodes[node.parent].visits.load(memory_order_relaxed);
+        }
+        double value = node.score.load(memory_order_relaxed) / visits;
+        const unsigned amaf_visits = node.amaf_visits.load(memory_order_relaxed);
+        if (rave_equivalence > 0 && amaf_visits > 0) {
+            // The AMAF share fades as the child's own visits grow
+            const double beta = sqrt(rave_equivalence / (3 * visits + rave_equivalence));
+            value = (1 - beta) * value + beta * node.amaf_score.load(memory_order_relaxed) / amaf_visits;
+        }
+        return value + c * sqrt(log(parent_visits) / visits);
+    }
+
+    // First index of the children of index, or a negative value when another thread
+    // is expanding it or the arena is full. Children are ranked by the state's move scores.
+    int expand(int index, const S *state, const vector<M> &legal_moves) {
+        int first_child = MCTS_UNEXPANDED;
+        if (!nodes[index].first_child.compare_exchange_strong(first_child, MCTS_EXPANDING, memory_order_acquire)) {
+            return first_child;
+        }
+        first_child = nodes.allocate(legal_moves.size());
+        if (first_child < 0) {
+            nodes[index].first_child.store(MCTS_UNEXPANDED, memory_order_relaxed);
+            return first_child;
+        }
+        vector<pair<int, int>> order;
+        order.reserve(legal_moves.size());
+        for (int i = 0; i < (int) legal_moves.size(); ++i) {
+            nodes[first_child + i].parent = index;
+            nodes[first_child + i].move = legal_moves[i].pack();
+            if (widening_k > 0) {
+                order.push_back({-state->score_move(legal_moves[i]), i});
             }
         }
-        else {
-            // minimize
-            double best_uct = INF;
-            for (const auto move : legal_moves) {
-                const auto child = state->get_child(move);
-                if (child != nullptr) {
-                    const auto uct = child->get_uct(-UCT_C);
-                    if (best_uct > uct) {
-                        best_uct = uct;
-                        best_move = move;
-                    }
-                } else {
-                    return move;
+        // Ties keep the legal move order
+        sort(order.begin(), order.end());
+        for (int rank = 0; rank < (int) order.size(); ++rank) {
+            nodes[first_child + order[rank].second].rank = rank;
+        }
+        nodes[index].child_count = legal_moves.size();
+        nodes[index].first_child.store(first_child, memory_order_release);
+        return first_child;
+    }
+
+    // Descends from the root to the first node not visited yet, making the moves on the worker's state.
+    // Every node chosen gets a virtual loss for the player choosing it, steering the other threads away.
+    void tree_policy(MCTSWorker<S, M> *worker, const S *root) {
+        S *state = &worker->state;
+        int index = 0;
+        while (!state->is_terminal()) {
+            const auto legal_moves = state->get_legal_moves();
+            int first_child = nodes[index].first_child.load(memory_order_acquire);
+            if (first_child == MCTS_UNEXPANDED) {
+                first_child = expand(index, state, legal_moves);
+            }
+            if (first_child < 0) {
+                return;
+            }
+            const int i = get_tree_policy_move(index, state, legal_moves, root);
+            const int child = first_child + i;
+            assert(nodes[child].move == legal_moves[i].pack());
+            const bool maximizing = state->player_to_move == root->player_to_move;
+            const double virtual_score = maximizing ? LOSE_SCORE : WIN_SCORE;
+            const unsigned previous_visits = nodes[child].visits.fetch_add(1, memory_order_relaxed);
+            nodes[child].add_score(virtual_score);
+            worker->path.push_back(child);
+            worker->virtual_scores.push_back(virtual_score);
+            state->make_move(legal_moves[i]);
+            worker->moves.push_back(legal_moves[i]);
+            worker->played.push_back({nodes[child].move, maximizing});
+            if (previous_visits == 0) {
+                return;
+            }
+            index = child;
+        }
+    }
+
+    // Child with the most visits, -1 if the node is not expanded or no child was visited
+    int get_most_visited_child(int index) const {
+        const MCTSNode &node = nodes[index];
+        const int first_child = node.first_child.load();
+        if (first_child < 0) {
+            return -1;
+        }
+        int best = -1;
+        double max_visits = -INF;
+        for (int i = 0; i < node.child_count; ++i) {
+            const auto visits = nodes[first_child + i].visits.load();
+            if (visits > 0 && max_visits < visits) {
+                max_visits = visits;
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    // Children of index UCT may choose from: those ranked below ceil(k * n^alpha)
+    int get_admitted_children(int index) const {
+        const MCTSNode &node = nodes[index];
+        if (widening_k <= 0) {
+            return node.child_count;
+        }
+        const unsigned visits = max(node.visits.load(memory_order_relaxed), 1u);
+        const int admitted = (int) ceil(widening_k * pow(visits, widening_alpha));
+        return min(admitted, node.child_count);
+    }
+
+    // Index of the child to descend into among the admitted ones,
+    // the best ranked unvisited one if any
+    int get_best_child(int index, const S *state, const S *root) const {
+        const MCTSNode &node = nodes[index];
+        // maximize for the root player, minimize for the enemy
+        const double c = state->player_to_move == root->player_to_move ? UCT_C : -UCT_C;
+        const double sign = state->player_to_move == root->player_to_move ? 1 : -1;
+        const int first_child = node.first_child.load(memory_order_relaxed);
+        const int admitted = get_admitted_children(index);
+        int best = 0;
+        double best_uct = -INF;
+        int unvisited = -1;
+        for (int i = 0; i < node.child_count; ++i) {
+            const int child = first_child + i;
+            if (nodes[child].rank >= admitted) {
+                continue;
+            }
+            if (nodes[child].visits.load(memory_order_relaxed) == 0) {
+                if (unvisited < 0 || nodes[child].rank < nodes[first_child + unvisited].rank) {
+                    unvisited = i;
                 }
+                continue;
+            }
+            if (unvisited >= 0) {
+                continue;
+            }
+            const auto uct = sign * get_uct(child, c);
+            if (best_uct < uct) {
+                best_uct = uct;
+                best = i;
             }
         }
-        return best_move;
+        return unvisited >= 0 ? unvisited : best;
     }
 
-    M get_random_move(const S *state) const {
+    M get_random_move(const S *state, Random &random) const {
         const auto legal_moves = state->get_legal_moves();
         assert(legal_moves.size() > 0);
         const int index = random.uniform(0, legal_moves.size() - 1);
         return legal_moves[index];
     }
 
-    shared_ptr<M> get_winning_move(const S *state) const {
-        const auto current_player = state->player_to_move;
-        const auto legal_moves = state->get_legal_moves();
-        S clone = state->clone();
-        assert(legal_moves.size() > 0);
-        for (const M &move : legal_moves) {
-            clone.make_move(move);
-            if (clone.is_winner(current_player)) {
-                return make_shared<M>(move);
+    // A blocking move found from the enemy's side is only taken if it is legal for us
+    int get_tree_policy_move(int index, S *state, const vector<M> &legal_moves, const S *root) const {
+        M move;
+        // If player has a winning move he makes it.
+        bool found = state->get_winning_move(move);
+        if (!found && block) {
+            // If player has a blocking move he makes it.
+            found = state->get_blocking_move(move);
+        }
+        if (found) {
+            const auto it = find(legal_moves.begin(), legal_moves.end(), move);
+            if (it != legal_moves.end()) {
+                return it - legal_moves.begin();
             }
-            clone.undo_move(move);
         }
-        return nullptr;
+        return get_best_child(index, state, root);
     }
 
-    shared_ptr<M> get_blocking_move(const S *state) const {
-        const auto current_player = state->player_to_move;
-        const auto enemy = state->get_enemy(current_player);
-        S enemy_state = state->clone();
-        enemy_state.player_to_move = enemy;
-        return get_winning_move(&enemy_state);
-    }
-
-    M get_tree_policy_move(S *state, const S *root) const {
+    // Checked against the legal moves like in the tree policy
+    M get_default_policy_move(S *state, Random &random) const {
+        M move;
         // If player has a winning move he makes it.
-        auto move_ptr = get_winning_move(state);
-        if (move_ptr != nullptr) {
-            return *move_ptr;
-        }
-        if (block) {
+        bool found = state->get_winning_move(move);
+        if (!found) {
             // If player has a blocking move he makes it.
-            move_ptr = get_blocking_move(state);
-            if (move_ptr != nullptr) {
-                return *move_ptr;
+            found = state->get_blocking_move(move);
+        }
+        if (!found) {
+            return get_random_move(state, random);
+        }
+        const auto legal_moves = state->get_legal_moves();
+        assert(legal_moves.size() > 0);
+        if (find(legal_moves.begin(), legal_moves.end(), move) != legal_moves.end()) {
+            return move;
+        }
+        return legal_moves[random.uniform(0, legal_moves.size() - 1)];
+    }
+
+    // Plays the default policy forward on a scratch copy, which is dropped at the end
+    double rollout(const S *current, const S *root, MCTSWorker<S, M> *worker) const {
+        S scratch = current->clone();
+        while (!scratch.is_terminal()) {
+            const M move = get_default_policy_move(&scratch, worker->random);
+            if (rave_equivalence > 0) {
+                worker->played.push_back({move.pack(), scratch.player_to_move == root->player_to_move});
             }
+            scratch.make_move(move);
+        }
+        if (scratch.is_winner(root->player_to_move)) {
+            return WIN_SCORE;
         }
-        return get_best_move(state, root);
+        if (scratch.is_winner(root->get_enemy(root->player_to_move))) {
+            return LOSE_SCORE;
+        }
+        return DRAW_SCORE;
     }
 
-    M get_default_policy_move(const S *state) const {
-        // If player has a winning move he makes it.
-        auto move_ptr = get_winning_move(state);
-        if (move_ptr != nullptr) {
-            return *move_ptr;
+    string get_name() const {
+        return "MonteCarloTreeSearch";
+    }
+
+};
+
+// Root parallelization: independent single-threaded trees with their own seeds,
+// one per thread, voting with the root visits they gave every move.
+// Nothing is shared while searching, max_nodes is split evenly between the trees.
+template<class S, class M>
+struct EnsembleMonteCarloTreeSearch : public Algorithm<S, M> {
+    vector<unique_ptr<MonteCarloTreeSearch<S, M>>> trees;
+
+    EnsembleMonteCarloTreeSearch(double max_seconds = 1,
+                                 int tree_count = 4,
+                                 int max_simulations = MAX_SIMULATIONS,
+                                 bool block = false,
+                                 int max_nodes = MCTS_MAX_NODES,
+                                 unsigned seed = 0) :
+        Algorithm<S, M>(),
+        trees(max(tree_count, 1)) {
+        const int tree_nodes = max(max_nodes / (int) trees.size(), 1);
+        for (int k = 0; k < (int) trees.size(); ++k) {
+            trees[k].reset(new MonteCarloTreeSearch<S, M>(
+                max_seconds, max_simulations, block, 1, tree_nodes, seed + k
+            ));
         }
-        // If player has a blocking move he makes it.
-        move_ptr = get_blocking_move(state);
-        if (move_ptr != nullptr) {
-            return *move_ptr;
+    }
+
+    void clear() {
+        for (auto &tree : trees) {
+            tree->clear();
         }
-        return get_random_move(state);
     }
 
-    double rollout(S *current, const S *root) const {
-        if (current->is_terminal()) {
-            if (current->is_winner(root->player_to_move)) {
-                return WIN_SCORE;
+    M get_move(const S *root) override {
+        // Thrown here, an exception in a search thread would terminate the process
+        if (root->is_terminal()) {
+            stringstream stream;
+            root->to_stream(stream);
+            throw invalid_argument("Given state is terminal:\n" + stream.str());
+        }
+        vector<thread> threads;
+        for (auto &tree : trees) {
+            MonteCarloTreeSearch<S, M> *t = tree.get();
+            threads.emplace_back([t, root] { t->search(root); });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        for (int k = 0; k < (int) trees.size(); ++k) {
+            trees[k]->read_log();
+            this->log << "tree " << k << " simulations: " << trees[k]->simulations << endl;
+        }
+        // Child i of every root belongs to the same i-th legal move
+        const auto legal_moves = root->get_legal_moves();
+        this->log << "moves: " << legal_moves.size() << endl;
+        int best = 0;
+        long long max_visits = -1;
+        for (int i = 0; i < (int) legal_moves.size(); ++i) {
+            long long visits = 0;
+            for (const auto &tree : trees) {
+                visits += tree->get_root_visits(i);
             }
-            if (current->is_winner(root->get_enemy(root->player_to_move))) {
-                return LOSE_SCORE;
+            this->log << "move: " << legal_moves[i] << " visits: " << visits << endl;
+            if (max_visits < visits) {
+                max_visits = visits;
+                best = i;
             }
-            return DRAW_SCORE;
         }
-        M move = get_default_policy_move(current);
-        current->make_move(move);
-        auto result = rollout(current, root);
-        current->undo_move(move);
-        return result;
+        if (max_visits == 0) {
+            // No tree had room for the root's children in its share of max_nodes
+            S state = root->clone();
+            return trees[0]->get_default_policy_move(&state, trees[0]->streams);
+        }
+        return legal_moves[best];
     }
 
     string get_name() const {
-        return "MonteCarloTreeSearch";
+        return "EnsembleMonteCarloTreeSearch";
     }
-
 };
 
 struct OutcomeCounts {
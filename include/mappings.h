@@ -1,7 +1,11 @@
 #ifndef yinsh_mappings
 #define yinsh_mappings
 
+#include <map>
 #include <unordered_map>
+#include <vector>
+
+#include "./uint128.h"
 
 /*
     Two mappings:
@@ -131,8 +135,8 @@ const unordered_map<bitboard_coord_t, unordered_map<bitboard_coord_t, bitboard_c
             sachin_coord_t start(i, j);
             auto start_bb = sachin2BitboardMap.find(start)->second;
 
-            uint128_t bitmask = 0;
             for (auto dir : directions) {
+                uint128_t bitmask = 0;
                 auto next = start + dir;
                 sachin_coord_t prev(0, 0); // 0 means no prev point (ugly special case to maintain exclusive boundaries)
 
@@ -173,8 +177,8 @@ const unordered_map<bitboard_coord_t, unordered_map<bitboard_coord_t, bitboard_c
             sachin_coord_t start(i, j);
             auto start_bb = sachin2BitboardMap.find(start)->second;
 
-            uint128_t bitmask = 0;
             for (auto dir : directions) {
+                uint128_t bitmask = 0;
                 auto end = start + dir*4;
                 if (!isValidSachinCoord(end)) {
                     continue;
@@ -192,6 +196,34 @@ const unordered_map<bitboard_coord_t, unordered_map<bitboard_coord_t, bitboard_c
     return m;
 }();
 
+// every 5-in-a-row bitmask on the board, each listed exactly once (S, SE and SW starting points)
+// e.g. for (auto window : row_windows) if ((board & window) == window) => row formed
+const std::vector<bitboard_coord_t> row_windows = [] {
+    std::vector<bitboard_coord_t> v;
+    const sachin_coord_t forward[] = { S, SE, SW };
+
+    for (int i = 0; i < 19; i++) {
+        for (int j = 0; j < 11; j++) {
+            if (sachinCoordsBoard[i][j] != E)
+                continue;
+
+            sachin_coord_t start(i, j);
+            for (auto dir : forward) {
+                if (!isValidSachinCoord(start + dir*4)) {
+                    continue;
+                }
+                bitboard_coord_t bitmask = 0;
+                for (int k = 0; k < 5; k++) {
+                    bitmask |= sachin2BitboardMap.find(start + dir*k)->second;
+                }
+                v.push_back(bitmask);
+            }
+        }
+    }
+
+    return v;
+}();
+
 // returns the element following p in d direction: next_element[d][p]
 const unordered_map<sachin_coord_t, unordered_map<bitboard_coord_t, bitboard_coord_t>> next_element = [] {
     unordered_map<sachin_coord_t, unordered_map<bitboard_coord_t, bitboard_coord_t>> m;
@@ -204,13 +236,10 @@ const unordered_map<sachin_coord_t, unordered_map<bitboard_coord_t, bitboard_coo
             sachin_coord_t start(i, j);
             auto start_bb = sachin2BitboardMap.find(start)->second;
 
-            uint128_t bitmask = 0;
             for (auto dir : directions) {
                 auto next = start + dir;
-
-                while (isValidSachinCoord(next)) {
-                    auto next_bb = sachin2BitboardMap.find(next)->second;
-                    m[dir][start_bb] = next_bb;
+                if (isValidSachinCoord(next)) {
+                    m[dir][start_bb] = sachin2BitboardMap.find(next)->second;
                 }
             }
         }
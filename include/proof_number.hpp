@@ -0,0 +1,269 @@
+#pragma once
+
+/*
+Depth-first proof-number (df-pn) endgame solver.
+
+The solver only answers whether the attacker can force a win. It tries that first
+for the player to move and then for the enemy. A proof is exact. A disproof only
+means no win was found within MAX_PLY plies of the root, so the table keeps it
+for the plies at or below the one it was found at. Positions that are not
+State::is_endgame, or that the solver cannot settle in time, go to Minimax.
+*/
+
+#include "gtsa.hpp"
+
+static const uint32_t PN_INF = 1u << 30;
+static const size_t PROOF_TABLE_MEGABYTES = 16;
+static const int PROOF_POLL_INTERVAL = 16;
+static const double PROOF_TIME_RATIO = 0.5;
+
+struct ProofEntry {
+    uint64_t key = 0;
+    uint32_t pn = 0;
+    uint32_t dn = 0;
+    // Nodes spent below the entry, entries with the least work are evicted first
+    uint64_t work = 0;
+    // Ply the numbers were found at, a disproof may rest on the MAX_PLY cut-off below it
+    int ply = 0;
+};
+
+// Bounded hash table of proof and disproof numbers, 4 slots per bucket.
+struct ProofTable {
+    static const int BUCKET_SLOTS = 4;
+
+    vector<ProofEntry> entries;
+    size_t bucket_mask = 0;
+    size_t stored = 0;
+
+    ProofTable(size_t megabytes = PROOF_TABLE_MEGABYTES) {
+        size_t buckets = 1;
+        while (buckets * 2 * BUCKET_SLOTS * sizeof(ProofEntry) <= megabytes << 20) {
+            buckets *= 2;
+        }
+        entries.resize(buckets * BUCKET_SLOTS);
+        bucket_mask = buckets - 1;
+    }
+
+    void clear() {
+        fill(entries.begin(), entries.end(), ProofEntry());
+        stored = 0;
+    }
+
+    ProofEntry *bucket(uint64_t key) {
+        return &entries[(key & bucket_mask) * BUCKET_SLOTS];
+    }
+
+    // Unknown positions start at pn = dn = 1, and so do disproofs found deeper than ply
+    void probe(uint64_t key, int ply, uint32_t &pn, uint32_t &dn) {
+        ProofEntry *slots = bucket(key);
+        for (int i = 0; i < BUCKET_SLOTS; ++i) {
+            if (slots[i].work > 0 && slots[i].key == key &&
+                (slots[i].pn < PN_INF || slots[i].ply <= ply)) {
+                pn = slots[i].pn;
+                dn = slots[i].dn;
+                return;
+            }
+        }
+        pn = 1;
+        dn = 1;
+    }
+
+    void store(uint64_t key, uint32_t pn, uint32_t dn, uint64_t work, int ply) {
+        ProofEntry *slots = bucket(key);
+        ProofEntry *victim = &slots[0];
+        for (int i = 0; i < BUCKET_SLOTS; ++i) {
+            if (slots[i].work > 0 && slots[i].key == key) {
+                victim = &slots[i];
+                break;
+            }
+            if (slots[i].work < victim->work) {
+                victim = &slots[i];
+            }
+        }
+        if (victim->work == 0) {
+            ++stored;
+        }
+        *victim = {key, pn, dn, max<uint64_t>(work, 1), ply};
+    }
+
+    double fill_rate() const {
+        return (double) stored / entries.size();
+    }
+};
+
+enum class ProofValue { UNKNOWN, WIN, LOSS };
+
+template<class M>
+struct ProofResult {
+    ProofValue value;
+    M move;
+};
+
+template<class S, class M, class P = StatePolicy<S, M>>
+struct ProofNumberSearch : public Algorithm<S, M> {
+
+    const double MAX_SECONDS;
+    const int MAX_MOVES;
+    ProofTable table;
+    Minimax<S, M, P> fallback;
+    TimeManager time_manager;
+    char attacker = 0;
+    long long nodes = 0;
+    // Proven child of the root, kept because the table may evict it before prove() returns
+    M root_move;
+
+    ProofNumberSearch(double max_seconds = 1, int max_moves = INF,
+                      size_t table_megabytes = PROOF_TABLE_MEGABYTES) :
+            Algorithm<S, M>(),
+            MAX_SECONDS(max_seconds),
+            MAX_MOVES(max_moves),
+            table(table_megabytes),
+            fallback(max_seconds, max_moves),
+            time_manager(PROOF_POLL_INTERVAL) {}
+
+    // The solver gets up to PROOF_TIME_RATIO of the time, Minimax the rest
+    M get_move(const S *state) override {
+        if (state->is_terminal()) {
+            stringstream stream;
+            state->to_stream(stream);
+            throw invalid_argument("Given state is terminal:\n" + stream.str());
+        }
+        Timer timer;
+        timer.start();
+        if (state->is_endgame()) {
+            const auto result = solve(state, MAX_SECONDS * PROOF_TIME_RATIO);
+            this->log << "df-pn: " << (result.value == ProofValue::WIN ? "win" :
+                                       result.value == ProofValue::LOSS ? "loss" : "unknown")
+            << " nodes: " << nodes
+            << " time: " << timer
+            << " table_fill: " << table.fill_rate() << endl;
+            if (result.value == ProofValue::WIN) {
+                return result.move;
+            }
+        }
+        // A lost position is still played by Minimax, which resists the longest
+        const M move = fallback.get_move(state, max(MAX_SECONDS - timer.seconds_elapsed(), 0.0));
+        this->log << fallback.read_log();
+        return move;
+    }
+
+    // Proves a win for the player to move, then for the enemy, within max_seconds.
+    // Only a win comes with a move.
+    ProofResult<M> solve(const S *state, double max_seconds) {
+        nodes = 0;
+        time_manager.start(max_seconds);
+        M move;
+        if (prove(state, state->player_to_move, move)) {
+            return {ProofValue::WIN, move};
+        }
+        if (!time_manager.hard_exceeded && prove(state, state->get_enemy(state->player_to_move), move)) {
+            return {ProofValue::LOSS, M()};
+        }
+        return {ProofValue::UNKNOWN, M()};
+    }
+
+    // The only place the table is cleared: proof numbers depend on the attacker,
+    // results of the other pass or an earlier move are useless.
+    bool prove(const S *state, char player, M &best_move) {
+        attacker = player;
+        table.clear();
+        S root = state->clone();
+        uint32_t pn, dn;
+        mid(root, PN_INF - 1, PN_INF - 1, 0, pn, dn);
+        if (pn == 0 && root.player_to_move == attacker) {
+            best_move = root_move;
+        }
+        return pn == 0;
+    }
+
+    bool is_or_node(const S &state) const {
+        return state.player_to_move == attacker;
+    }
+
+    // Numbers of a node at ply. Beyond MAX_PLY a node counts as disproved,
+    // that cut-off is never stored.
+    void evaluate(const S &state, int ply, uint32_t &pn, uint32_t &dn) {
+        if (state.is_terminal()) {
+            pn = state.is_winner(attacker) ? 0 : PN_INF;
+            dn = state.is_winner(attacker) ? PN_INF : 0;
+        } else if (ply >= MAX_PLY) {
+            pn = PN_INF;
+            dn = 0;
+        } else {
+            table.probe(state.hash(), ply, pn, dn);
+        }
+    }
+
+    static uint32_t add(uint32_t a, uint32_t b) {
+        if (a >= PN_INF || b >= PN_INF) {
+            return PN_INF;
+        }
+        return min(a + b, PN_INF - 1);
+    }
+
+    // Multiple iterative deepening: searches below the node until its proof
+    // or disproof number reaches the threshold, then stores both numbers.
+    // The player to move does not always alternate, so every node checks its type.
+    void mid(S &state, uint32_t threshold_pn, uint32_t threshold_dn, int ply,
+             uint32_t &pn, uint32_t &dn) {
+        ++nodes;
+        const long long nodes_before = nodes;
+        const uint64_t key = state.hash();
+        const auto moves = P::get_legal_moves(&state, MAX_MOVES);
+        if (moves.empty()) {
+            pn = PN_INF;
+            dn = 0;
+            table.store(key, pn, dn, 1, ply);
+            return;
+        }
+        const bool or_node = is_or_node(state);
+        vector<S> children;
+        children.reserve(moves.size());
+        for (const auto &move : moves) {
+            children.push_back(state.clone());
+            children.back().make_move(move);
+        }
+        vector<uint32_t> child_pn(moves.size()), child_dn(moves.size());
+        while (true) {
+            // An OR node needs one proven child and an AND node needs all of them
+            uint32_t min_number = PN_INF, second_number = PN_INF, sum_number = 0;
+            int best = 0;
+            for (int i = 0; i < (int) children.size(); ++i) {
+                evaluate(children[i], ply + 1, child_pn[i], child_dn[i]);
+                const uint32_t minimized = or_node ? child_pn[i] : child_dn[i];
+                const uint32_t summed = or_node ? child_dn[i] : child_pn[i];
+                if (minimized < min_number) {
+                    second_number = min_number;
+                    min_number = minimized;
+                    best = i;
+                } else if (minimized < second_number) {
+                    second_number = minimized;
+                }
+                sum_number = add(sum_number, summed);
+            }
+            pn = or_node ? min_number : sum_number;
+            dn = or_node ? sum_number : min_number;
+            if (ply == 0 && or_node && pn == 0) {
+                root_move = moves[best];
+            }
+            if (pn >= threshold_pn || dn >= threshold_dn || time_manager.poll()) {
+                break;
+            }
+            uint32_t next_pn, next_dn;
+            if (or_node) {
+                next_pn = min(threshold_pn, add(second_number, 1));
+                next_dn = threshold_dn - dn + child_dn[best];
+            } else {
+                next_pn = threshold_pn - pn + child_pn[best];
+                next_dn = min(threshold_dn, add(second_number, 1));
+            }
+            uint32_t unused_pn, unused_dn;
+            mid(children[best], next_pn, next_dn, ply + 1, unused_pn, unused_dn);
+        }
+        table.store(key, pn, dn, nodes - nodes_before + 1, ply);
+    }
+
+    string get_name() const {
+        return "ProofNumberSearch";
+    }
+};
@@ -0,0 +1,518 @@
+#pragma once
+
+/*
+Root-split Minimax over worker processes on the same host.
+
+The coordinator forks its workers once, so each worker starts with the position.
+Workers outlive get_move: a later position reachable within ROOT_SPLIT_REUSE_MAX_PLIES
+is sent as legal move indices to play, otherwise the workers are forked again.
+Root moves also travel as indices, over a Unix domain socket pair per worker.
+Workers search one root move at a time with their own Minimax and transposition
+table, which they keep across moves. A crashed worker only loses its current job,
+which goes back to the queue, and the pool is forked again at the next move.
+*/
+
+#include "gtsa.hpp"
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <signal.h>
+#include <cerrno>
+#include <unistd.h>
+#include <deque>
+
+static const int ROOT_SPLIT_ESTIMATE_DEPTH = 2;
+static const size_t ROOT_SPLIT_WORKER_TT_MEGABYTES = 16;
+static const int ROOT_SPLIT_REUSE_MAX_PLIES = 2;
+static const int ROOT_SPLIT_STOP_TIMEOUT_MS = 1000;
+
+// ADVANCE plays legal move move_index on the worker's position, NEW_SEARCH starts a get_move,
+// STOP abandons the running job, which still answers with an incomplete RESULT.
+enum RootSplitMessageType { JOB, BOUND, RESULT, QUIT, STOP, ADVANCE, NEW_SEARCH };
+
+// Fixed size, SOCK_SEQPACKET keeps message boundaries.
+struct RootSplitMessage {
+    int type = JOB;
+    int move_index = 0;
+    int depth = 0;
+    int alpha = -INF;
+    int beta = INF;
+    int goodness = 0;
+    int completed = 0;
+    long long nodes = 0;
+    double seconds = 0;
+};
+
+inline bool send_message(int fd, const RootSplitMessage &message) {
+    return send(fd, &message, sizeof(message), MSG_NOSIGNAL) == sizeof(message);
+}
+
+// 1 if a message was read, 0 if none is waiting (non-blocking only), -1 if the peer is gone.
+inline int receive_message(int fd, RootSplitMessage &message, bool block) {
+    const ssize_t received = recv(fd, &message, sizeof(message), block ? 0 : MSG_DONTWAIT);
+    if (received == sizeof(message)) {
+        return 1;
+    }
+    if (received < 0 && !block && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return 0;
+    }
+    return -1;
+}
+
+template<class S, class M, class P = StatePolicy<S, M>>
+struct RootSplitMinimax : public Algorithm<S, M> {
+
+    struct Worker {
+        pid_t pid;
+        int fd;
+        int move_index;
+        bool alive;
+    };
+
+    const double MAX_SECONDS;
+    const int MAX_MOVES;
+    const int WORKERS;
+    vector<Worker> workers;
+    // Position the workers hold
+    unique_ptr<S> workers_root;
+    TimeManager time_manager;
+
+    RootSplitMinimax(double max_seconds = 1, int max_moves = INF, int workers = 4) :
+            Algorithm<S, M>(),
+            MAX_SECONDS(max_seconds),
+            MAX_MOVES(max_moves),
+            WORKERS(max(workers, 1)) {}
+
+    ~RootSplitMinimax() {
+        stop_workers();
+    }
+
+    M get_move(const S *state) override {
+        if (state->is_terminal()) {
+            stringstream stream;
+            state->to_stream(stream);
+            throw invalid_argument("Given state is terminal:\n" + stream.str());
+        }
+        time_manager.start(MAX_SECONDS);
+        const auto moves = P::get_legal_moves(state, MAX_MOVES);
+        this->log << "moves: " << moves.size() << endl;
+        M best_move = moves[0];
+        if (moves.size() == 1) {
+            return best_move;
+        }
+
+        // Largest subtrees first, so no worker is left with a big one at the end
+        vector<long long> estimates = estimate_subtree_sizes(state, moves);
+        vector<int> order(moves.size());
+        for (int i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        stable_sort(order.begin(), order.end(), [&estimates](int a, int b) { return estimates[a] > estimates[b]; });
+
+        prepare_workers(state);
+        for (int max_depth = 1; max_depth <= MAX_DEPTH; ++max_depth) {
+            int best_index;
+            int goodness;
+            long long nodes;
+            if (!search_depth(max_depth, order, estimates, best_index, goodness, nodes)) {
+                break;
+            }
+            time_manager.iteration_completed(!(moves[best_index] == best_move));
+            best_move = moves[best_index];
+            // Best move keeps going first, the rest by the node counts just measured
+            stable_sort(order.begin(), order.end(), [&estimates](int a, int b) { return estimates[a] > estimates[b]; });
+            order.erase(find(order.begin(), order.end(), best_index));
+            order.insert(order.begin(), best_index);
+            this->log << "goodness: " << goodness
+            << " time: " << time_manager
+            << " move: " << best_move
+            << " nodes: " << nodes
+            << " workers: " << alive_workers()
+            << " max_depth: " << max_depth << endl;
+            if (time_manager.soft_exceeded()) {
+                break;
+            }
+        }
+        stop_jobs();
+        return best_move;
+    }
+
+    // Moves the workers to the state, forking them again when that is not possible
+    void prepare_workers(const S *state) {
+        vector<int> path;
+        if (workers.empty() || alive_workers() < workers.size() ||
+            !find_path(workers_root.get(), state, path)) {
+            stop_workers();
+            start_workers(state);
+        } else {
+            for (int index : path) {
+                RootSplitMessage advance;
+                advance.type = ADVANCE;
+                advance.move_index = index;
+                send_to_workers(advance);
+            }
+            this->log << "workers reused, plies: " << path.size() << endl;
+        }
+        workers_root.reset(new S(state->clone()));
+        RootSplitMessage new_search;
+        new_search.type = NEW_SEARCH;
+        send_to_workers(new_search);
+    }
+
+    // Legal move indices leading from one state to the other, shortest first
+    bool find_path(const S *from, const S *to, vector<int> &path) const {
+        S state = from->clone();
+        for (int plies = 0; plies <= ROOT_SPLIT_REUSE_MAX_PLIES; ++plies) {
+            path.clear();
+            if (find_path(state, to, plies, path)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool find_path(S &state, const S *to, int plies, vector<int> &path) const {
+        if (plies == 0) {
+            return state.player_to_move == to->player_to_move && state.hash() == to->hash() && state == *to;
+        }
+        if (state.is_terminal()) {
+            return false;
+        }
+        const auto legal_moves = state.get_legal_moves();
+        for (int i = 0; i < legal_moves.size(); ++i) {
+            state.make_move(legal_moves[i]);
+            path.push_back(i);
+            const bool found = find_path(state, to, plies - 1, path);
+            state.undo_move(legal_moves[i]);
+            if (found) {
+                return true;
+            }
+            path.pop_back();
+        }
+        return false;
+    }
+
+    // Node count of a shallow search below every root move
+    vector<long long> estimate_subtree_sizes(const S *state, const vector<M> &moves) {
+        Minimax<S, M, P> estimator(MAX_SECONDS, MAX_MOVES, 1);
+        estimator.time_manager.start(MAX_SECONDS);
+        estimator.reset_ordering();
+        vector<long long> estimates;
+        for (const auto &move : moves) {
+            S clone = state->clone();
+            clone.make_move(move);
+            estimator.reset_stats();
+            estimator.minimax(&clone, ROOT_SPLIT_ESTIMATE_DEPTH - 1, -INF, INF, 1);
+            estimates.push_back(estimator.stats.nodes);
+        }
+        return estimates;
+    }
+
+    void start_workers(const S *state) {
+        workers.clear();
+        for (int i = 0; i < WORKERS; ++i) {
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) != 0) {
+                this->log << "socketpair failed, running with " << workers.size() << " workers" << endl;
+                break;
+            }
+            const pid_t pid = fork();
+            if (pid < 0) {
+                close(fds[0]);
+                close(fds[1]);
+                this->log << "fork failed, running with " << workers.size() << " workers" << endl;
+                break;
+            }
+            if (pid == 0) {
+                close(fds[0]);
+                for (const auto &worker : workers) {
+                    close(worker.fd);
+                }
+                worker_loop(fds[1], state);
+                _exit(0);
+            }
+            close(fds[1]);
+            workers.push_back({pid, fds[0], -1, true});
+        }
+    }
+
+    void stop_workers() {
+        RootSplitMessage quit;
+        quit.type = QUIT;
+        for (auto &worker : workers) {
+            if (worker.alive) {
+                send_message(worker.fd, quit);
+                close(worker.fd);
+                waitpid(worker.pid, nullptr, 0);
+            }
+        }
+        workers.clear();
+        workers_root.reset();
+    }
+
+    // Ends the jobs still running and waits for their answers, so the workers are idle
+    // for the next move. A worker not answering in time is killed.
+    void stop_jobs() {
+        RootSplitMessage stop;
+        stop.type = STOP;
+        deque<int> unused;
+        for (auto &worker : workers) {
+            if (!worker.alive || worker.move_index < 0) {
+                continue;
+            }
+            pollfd fd = {worker.fd, POLLIN, 0};
+            RootSplitMessage result;
+            if (!send_message(worker.fd, stop) || poll(&fd, 1, ROOT_SPLIT_STOP_TIMEOUT_MS) <= 0 ||
+                receive_message(worker.fd, result, true) < 0) {
+                worker_failed(worker, unused);
+            }
+            worker.move_index = -1;
+        }
+    }
+
+    void send_to_workers(const RootSplitMessage &message) {
+        deque<int> unused;
+        for (auto &worker : workers) {
+            if (worker.alive && !send_message(worker.fd, message)) {
+                worker_failed(worker, unused);
+            }
+        }
+    }
+
+    int alive_workers() const {
+        int alive = 0;
+        for (const auto &worker : workers) {
+            alive += worker.alive;
+        }
+        return alive;
+    }
+
+    // One depth: the first root move alone sets alpha, then the rest is spread over the
+    // idle workers and every improvement of alpha is pushed to the busy ones.
+    // False when time ran out or no worker is left.
+    bool search_depth(int depth, const vector<int> &order, vector<long long> &estimates,
+                      int &best_index, int &best_goodness, long long &nodes) {
+        deque<int> queue(order.begin(), order.end());
+        int alpha = -INF;
+        bool first_done = false;
+        int busy = 0;
+        best_index = -1;
+        nodes = 0;
+        for (auto &worker : workers) {
+            worker.move_index = -1;
+        }
+        while (!queue.empty() || busy > 0) {
+            for (auto &worker : workers) {
+                if (queue.empty() || (!first_done && busy > 0)) {
+                    break;
+                }
+                if (!worker.alive || worker.move_index >= 0) {
+                    continue;
+                }
+                RootSplitMessage job;
+                job.type = JOB;
+                job.move_index = queue.front();
+                job.depth = depth;
+                job.alpha = alpha;
+                job.seconds = MAX_SECONDS - time_manager.seconds_elapsed();
+                if (!send_message(worker.fd, job)) {
+                    worker_failed(worker, queue);
+                    continue;
+                }
+                worker.move_index = job.move_index;
+                queue.pop_front();
+                ++busy;
+            }
+            if (busy == 0) {
+                if (alive_workers() == 0) {
+                    this->log << "no workers left" << endl;
+                }
+                return false;
+            }
+
+            vector<pollfd> fds;
+            vector<Worker*> polled;
+            for (auto &worker : workers) {
+                if (worker.alive && worker.move_index >= 0) {
+                    fds.push_back({worker.fd, POLLIN, 0});
+                    polled.push_back(&worker);
+                }
+            }
+            const int timeout_ms = max(0, (int) ((MAX_SECONDS - time_manager.seconds_elapsed()) * 1000));
+            if (poll(fds.data(), fds.size(), timeout_ms) <= 0) {
+                return false;
+            }
+            for (int i = 0; i < fds.size(); ++i) {
+                if (fds[i].revents == 0) {
+                    continue;
+                }
+                Worker &worker = *polled[i];
+                RootSplitMessage result;
+                if (receive_message(worker.fd, result, true) < 0) {
+                    --busy;
+                    worker_failed(worker, queue);
+                    continue;
+                }
+                --busy;
+                worker.move_index = -1;
+                if (result.depth != depth) {
+                    continue;
+                }
+                if (!result.completed) {
+                    return false;
+                }
+                first_done = true;
+                nodes += result.nodes;
+                estimates[result.move_index] = result.nodes;
+                if (best_index < 0 || alpha < result.goodness) {
+                    alpha = result.goodness;
+                    best_index = result.move_index;
+                    push_bound(depth, alpha);
+                }
+            }
+        }
+        best_goodness = alpha;
+        return best_index >= 0;
+    }
+
+    void worker_failed(Worker &worker, deque<int> &queue) {
+        this->log << "worker " << worker.pid << " failed";
+        if (worker.move_index >= 0) {
+            this->log << ", requeued move " << worker.move_index;
+            queue.push_front(worker.move_index);
+        }
+        this->log << endl;
+        worker.alive = false;
+        worker.move_index = -1;
+        close(worker.fd);
+        worker.fd = -1;
+        kill(worker.pid, SIGKILL);
+        waitpid(worker.pid, nullptr, 0);
+    }
+
+    void push_bound(int depth, int alpha) {
+        RootSplitMessage bound;
+        bound.type = BOUND;
+        bound.depth = depth;
+        bound.alpha = alpha;
+        for (auto &worker : workers) {
+            if (worker.alive && worker.move_index >= 0) {
+                send_message(worker.fd, bound);
+            }
+        }
+    }
+
+    // Runs in the forked worker, on its own copy of the position. Bounds, STOP and QUIT
+    // arriving during a search are read every time the searcher looks at its clock.
+    void worker_loop(int fd, const S *state) {
+        S position = state->clone();
+        vector<M> moves;
+        Minimax<S, M, P> searcher(MAX_SECONDS, MAX_MOVES, ROOT_SPLIT_WORKER_TT_MEGABYTES);
+        int current_depth = 0;
+        int alpha_bound = -INF;
+        // Alpha of the running search, a bound above it restarts the search
+        int window_alpha = -INF;
+        bool stop_job = false;
+        bool quit = false;
+        searcher.time_manager.on_poll = [&] {
+            RootSplitMessage message;
+            while (receive_message(fd, message, false) > 0) {
+                if (message.type == QUIT) {
+                    quit = true;
+                } else if (message.type == STOP) {
+                    stop_job = true;
+                } else if (message.type == BOUND && message.depth == current_depth) {
+                    alpha_bound = max(alpha_bound, message.alpha);
+                }
+            }
+            return quit || stop_job || alpha_bound > window_alpha;
+        };
+        RootSplitMessage message;
+        while (!quit && receive_message(fd, message, true) > 0) {
+            if (message.type == QUIT) {
+                break;
+            }
+            if (message.type == STOP) {
+                continue;
+            }
+            if (message.type == ADVANCE) {
+                position.make_move(position.get_legal_moves()[message.move_index]);
+                continue;
+            }
+            if (message.type == NEW_SEARCH) {
+                moves = P::get_legal_moves(&position, MAX_MOVES);
+                searcher.transposition_table->new_search();
+                searcher.reset_ordering();
+                current_depth = 0;
+                alpha_bound = -INF;
+                continue;
+            }
+            if (message.type == BOUND) {
+                if (message.depth == current_depth) {
+                    alpha_bound = max(alpha_bound, message.alpha);
+                }
+                continue;
+            }
+            if (message.depth != current_depth) {
+                current_depth = message.depth;
+                alpha_bound = -INF;
+            }
+            alpha_bound = max(alpha_bound, message.alpha);
+            stop_job = false;
+            const RootSplitMessage result = search_job(searcher, &position, moves, message,
+                                                       alpha_bound, window_alpha, stop_job, quit);
+            window_alpha = -INF;
+            if (!send_message(fd, result)) {
+                break;
+            }
+        }
+        close(fd);
+    }
+
+    // Scores one root move from the root's point of view. Later moves first try a null window
+    // at the best bound known, and only a move that beats it is searched again with an open window.
+    // A bound arriving during the search raises the window: the search starts over with it,
+    // finding what it already did in the transposition table.
+    RootSplitMessage search_job(Minimax<S, M, P> &searcher, const S *state, const vector<M> &moves,
+                                const RootSplitMessage &job, const int &alpha_bound, int &window_alpha,
+                                const bool &stop_job, const bool &quit) {
+        Timer timer;
+        timer.start();
+        searcher.reset_stats();
+        S clone = state->clone();
+        clone.make_move(moves[job.move_index]);
+        const bool passed = clone.player_to_move != state->player_to_move;
+        const int depth = job.depth - 1;
+        int goodness;
+        while (true) {
+            searcher.time_manager.start(max(job.seconds - timer.seconds_elapsed(), 0.0));
+            searcher.stop->store(false);
+            window_alpha = alpha_bound;
+            const int alpha = window_alpha;
+            if (alpha == -INF) {
+                goodness = searcher.search_child(&clone, passed, depth, -INF, INF, 1);
+            } else {
+                goodness = searcher.search_child(&clone, passed, depth, alpha, alpha + 1, 1);
+                if (goodness > alpha && !searcher.stop->load()) {
+                    goodness = searcher.search_child(&clone, passed, depth, alpha, INF, 1);
+                }
+            }
+            const bool raised = alpha_bound > alpha;
+            if (!searcher.stop->load() || !raised || stop_job || quit || timer.seconds_elapsed() >= job.seconds) {
+                break;
+            }
+        }
+        RootSplitMessage result;
+        result.type = RESULT;
+        result.move_index = job.move_index;
+        result.depth = job.depth;
+        result.goodness = goodness;
+        result.completed = !searcher.stop->load();
+        result.nodes = searcher.stats.nodes;
+        return result;
+    }
+
+    string get_name() const {
+        return "RootSplitMinimax";
+    }
+};
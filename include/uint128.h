@@ -1,8 +1,9 @@
 #ifndef yinsh_uint128
 #define yinsh_uint128
 
-#include <iterator>
 #include <bitset>
+#include <iterator>
+#include <ostream>
 
 using namespace std;
 
@@ -38,5 +39,23 @@ inline bitset<128> getbitset(uint128_t x) {
     return (hi << 64) | lo;
 }
 
+inline int popcount(uint128_t x) {
+    return __builtin_popcountll(static_cast<unsigned long long>(x)) +
+           __builtin_popcountll(static_cast<unsigned long long>(x >> 64));
+}
+
+// Index of the lowest set bit, -1 for an empty board
+inline int bit_index(uint128_t x) {
+    const unsigned long long lo = static_cast<unsigned long long>(x);
+    const unsigned long long hi = static_cast<unsigned long long>(x >> 64);
+    if (lo != 0) {
+        return __builtin_ctzll(lo);
+    }
+    if (hi != 0) {
+        return 64 + __builtin_ctzll(hi);
+    }
+    return -1;
+}
+
 
 #endif
@@ -7,6 +7,7 @@
 
 #include "./uint128.h"
 #include "./mappings.h"
+#include "./yinsh_rows.h"
 #include "./gtsa.hpp"
 #include "utils.h"
 
@@ -84,6 +85,17 @@ struct YinshMove : public Move<YinshMove> {
 		return hash3();
 	}
 
+	// type (2 bits) | ring_pos index (7 bits) | ring_dest index (7 bits)
+	// Type 3 moves keep only 14 bits of their hash
+	PackedMove pack() const override {
+		if (type == 1)
+			return (1 << 14) | (bit_index(ring_pos) << 7);
+		if (type == 2)
+			return (2 << 14) | (bit_index(ring_pos) << 7) | bit_index(ring_dest);
+
+		return (3 << 14) | (hash3() & 0x3fff);
+	}
+
 	// Type 1 stuff
 	void read1(istream &stream = cin) {
 		if (&stream == &cin) {
@@ -220,7 +232,7 @@ struct YinshState : public State<YinshState, YinshMove> {
 		no_of_rings_removed_2 = 0;
 	}
 
-	YinshState clone() const override {
+	YinshState clone() const {
 		YinshState clone = YinshState();
 		clone.board_1 = Board(board_1);
 		clone.board_2 = Board(board_2);
@@ -445,7 +457,7 @@ float markerScore(uint128_t b, std::vector<uint128_t> rings){
 	return marker_score;
 }
 
-	int get_goodness() const override {
+	int get_goodness() const {
 		float no_B_markers = countMarkers(board_2.board);
 		float no_W_markers = countMarkers(board_1.board);
 
@@ -548,7 +560,7 @@ float markerScore(uint128_t b, std::vector<uint128_t> rings){
 		}
 	}
 
-	std::vector<YinshMove> get_legal_moves(int max_moves = INF) const override {
+	std::vector<YinshMove> get_legal_moves(int max_moves = INF) const {
 		auto combined_board = board_1.board | board_2.board;
 		auto &rings = player_to_move == PLAYER_1 ? rings_1 : rings_2;
 		auto &all_rings = player_to_move == PLAYER_1 ? all_rings_1 : all_rings_2;
@@ -644,16 +656,225 @@ float markerScore(uint128_t b, std::vector<uint128_t> rings){
 		}
 	}
 
-	char get_enemy(char player) const override {
+	uint128_t ring_mask(const std::vector<uint128_t>& rings) const {
+		uint128_t mask = 0;
+		for(auto ring: rings) {
+			mask |= ring;
+		}
+		return mask;
+	}
+
+	// Own and enemy markers after a ring move, and the cells whose marker it changes
+	void markers_after_move(const YinshMove& move,
+							uint128_t& markers_after,
+							uint128_t& enemy_markers_after,
+							uint128_t& changed) const {
+		auto& board = (player_to_move == PLAYER_1) ? board_1 : board_2;
+		auto& enemy_board = (player_to_move == PLAYER_1) ? board_2 : board_1;
+		auto& rings = (player_to_move == PLAYER_1) ? rings_1 : rings_2;
+		auto& enemy_rings = (player_to_move == PLAYER_1) ? rings_2 : rings_1;
+		uint128_t markers = board.board & ~ring_mask(rings);
+		uint128_t enemy_markers = enemy_board.board & ~ring_mask(enemy_rings);
+		markers_after_ring_move(markers, enemy_markers, move.ring_pos, move.ring_dest,
+								markers_after, enemy_markers_after, changed);
+	}
+
+	// A ring move is not quiet if a row window touched by the new marker or the
+	// flipped markers ends up with 4 or 5 markers of one colour.
+	// Placements are always quiet, row removals never are.
+	bool is_quiet(const YinshMove& move) const {
+		if (move.type == 1)
+			return true;
+		if (move.type == 3)
+			return false;
+
+		uint128_t markers_after, enemy_markers_after, changed;
+		markers_after_move(move, markers_after, enemy_markers_after, changed);
+		for(auto window: row_windows) {
+			if((window & changed) == 0) {
+				continue;
+			}
+			if(popcount(markers_after & window) >= 4 ||
+			   popcount(enemy_markers_after & window) >= 4) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Pending row removals, ring moves completing a row and ring moves breaking
+	// an enemy row of 4 markers plus an empty cell.
+	std::vector<YinshMove> get_forcing_moves() const {
+		auto &rows_formed = player_to_move == PLAYER_1 ? rows_formed_1 : rows_formed_2;
+		std::vector<YinshMove> moves = get_legal_moves();
+		if(!rows_formed.empty()) {
+			return moves;
+		}
+
+		auto& enemy_board = (player_to_move == PLAYER_1) ? board_2 : board_1;
+		auto& enemy_rings = (player_to_move == PLAYER_1) ? rings_2 : rings_1;
+		uint128_t enemy_markers = enemy_board.board & ~ring_mask(enemy_rings);
+		uint128_t empty = valid_positions & ~(board_1.board | board_2.board);
+		std::vector<uint128_t> threats;
+		for(auto window: row_windows) {
+			if(popcount(enemy_markers & window) == 4 && (empty & window) != 0) {
+				threats.push_back(window);
+			}
+		}
+
+		std::vector<YinshMove> forcing;
+		for(auto& move: moves) {
+			if(move.type != 2) {
+				continue;
+			}
+			uint128_t markers_after, enemy_markers_after, changed;
+			markers_after_move(move, markers_after, enemy_markers_after, changed);
+			bool is_forcing = false;
+			for(auto window: row_windows) {
+				if((window & changed) != 0 && (markers_after & window) == window) {
+					is_forcing = true;
+					break;
+				}
+			}
+			for(auto window: threats) {
+				if(is_forcing) {
+					break;
+				}
+				uint128_t occupied = (empty & window & (move.ring_dest | markers_after)) |
+									 (window & ~enemy_markers_after & enemy_markers);
+				if(occupied != 0) {
+					is_forcing = true;
+				}
+			}
+			if(is_forcing) {
+				forcing.push_back(move);
+			}
+		}
+		return forcing;
+	}
+
+	// Row windows the player could fill with its markers by one ring move
+	std::vector<uint128_t> completable_windows(char player) const {
+		auto& board = (player == PLAYER_1) ? board_1 : board_2;
+		auto& enemy_board = (player == PLAYER_1) ? board_2 : board_1;
+		uint128_t rings = ring_mask(player == PLAYER_1 ? rings_1 : rings_2);
+		uint128_t enemy_rings = ring_mask(player == PLAYER_1 ? rings_2 : rings_1);
+		return completable_row_windows(board.board & ~rings, rings, enemy_board.board & ~enemy_rings);
+	}
+
+	// With two rings removed a completed row wins: the player keeps the move and removes it.
+	// So a pending removal or a ring move completing a row counts as winning. Below two
+	// removed rings nothing wins at once and no move is generated.
+	bool get_winning_move(YinshMove& winning_move) const {
+		auto &rows_formed = player_to_move == PLAYER_1 ? rows_formed_1 : rows_formed_2;
+		uint64_t no_of_rings_removed =
+			(player_to_move == PLAYER_1) ? no_of_rings_removed_1 : no_of_rings_removed_2;
+		if(no_of_rings_removed < 2)
+			return false;
+		if(!rows_formed.empty()) {
+			std::vector<YinshMove> moves = get_legal_moves();
+			if(moves.empty())
+				return false;
+			winning_move = moves[0];
+			return true;
+		}
+		std::vector<uint128_t> windows = completable_windows(player_to_move);
+		if(windows.empty())
+			return false;
+		for(auto& move: get_legal_moves()) {
+			if(move.type != 2)
+				continue;
+			uint128_t markers_after, enemy_markers_after, changed;
+			markers_after_move(move, markers_after, enemy_markers_after, changed);
+			if(fills_window(windows, markers_after)) {
+				winning_move = move;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// A ring move after which the enemy cannot complete a row by its next ring move,
+	// because markers in the row windows changed colour the wrong way for it.
+	// A pending enemy removal cannot be blocked.
+	bool get_blocking_move(YinshMove& blocking_move) const {
+		char enemy = get_enemy(player_to_move);
+		auto &enemy_rows_formed = enemy == PLAYER_1 ? rows_formed_1 : rows_formed_2;
+		uint64_t enemy_rings_removed =
+			(enemy == PLAYER_1) ? no_of_rings_removed_1 : no_of_rings_removed_2;
+		if(enemy_rings_removed < 2 || !enemy_rows_formed.empty())
+			return false;
+		std::vector<uint128_t> threats = completable_windows(enemy);
+		if(threats.empty())
+			return false;
+		uint128_t enemy_rings = ring_mask(enemy == PLAYER_1 ? rings_1 : rings_2);
+		for(auto& move: get_legal_moves()) {
+			if(move.type != 2)
+				continue;
+			uint128_t markers_after, enemy_markers_after, changed;
+			markers_after_move(move, markers_after, enemy_markers_after, changed);
+			if(blocks_threats(threats, changed, markers_after, enemy_markers_after, enemy_rings)) {
+				blocking_move = move;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Move order for MCTS widening. Placements prefer cells on many row windows. Ring moves
+	// score the marker swing plus the windows they bring to 4 or 5 of our markers or take
+	// below 4 enemy markers. Row removals are all there is when pending.
+	int score_move(const YinshMove& move) const {
+		if (move.type == 3)
+			return 0;
+		if (move.type == 1) {
+			int windows = 0;
+			for(auto window: row_windows) {
+				if((window & move.ring_pos) != 0) {
+					windows++;
+				}
+			}
+			return windows;
+		}
+
+		auto& enemy_board = (player_to_move == PLAYER_1) ? board_2 : board_1;
+		auto& enemy_rings = (player_to_move == PLAYER_1) ? rings_2 : rings_1;
+		uint128_t enemy_markers = enemy_board.board & ~ring_mask(enemy_rings);
+		uint128_t markers_after, enemy_markers_after, changed;
+		markers_after_move(move, markers_after, enemy_markers_after, changed);
+		int score = 2 * (popcount(enemy_markers) - popcount(enemy_markers_after));
+		for(auto window: row_windows) {
+			if((window & changed) == 0) {
+				continue;
+			}
+			int own = popcount(markers_after & window);
+			if(own == 5) {
+				score += 100;
+			} else if(own == 4) {
+				score += 10;
+			}
+			if(popcount(enemy_markers & window) >= 4 && popcount(enemy_markers_after & window) < 4) {
+				score += 20;
+			}
+		}
+		return score;
+	}
+
+	char get_enemy(char player) const {
 		return (player == PLAYER_1) ? PLAYER_2 : PLAYER_1;
 	}
 
-	bool is_terminal() const override {
+	bool is_terminal() const {
 		return is_winner(player_to_move) ||
 			   is_winner(get_enemy(player_to_move));
 	}
 
-	bool is_winner(char player) const override {
+	// One more row wins for a player with two rings already removed
+	bool is_endgame() const {
+		return no_of_rings_removed_1 >= 2 || no_of_rings_removed_2 >= 2;
+	}
+
+	bool is_winner(char player) const {
 		uint64_t no_of_rings_removed =
 			(player == PLAYER_1) ? no_of_rings_removed_1 : no_of_rings_removed_2;
 		if (no_of_rings_removed >= 3)
@@ -765,7 +986,7 @@ float markerScore(uint128_t b, std::vector<uint128_t> rings){
 		update_rows_formed();
 	}
 
-	void make_move(const YinshMove& move) override {
+	void make_move(const YinshMove& move) {
 		auto& board = (player_to_move == PLAYER_1) ? board_1 : board_2;
 		auto &no_of_rings_placed =
 			player_to_move == PLAYER_1 ? no_of_rings_placed_1 : no_of_rings_placed_2;
@@ -796,7 +1017,7 @@ float markerScore(uint128_t b, std::vector<uint128_t> rings){
 		}
 	}
 
-	void undo_move(const YinshMove& move) override {
+	void undo_move(const YinshMove& move) {
 		auto& board = (player_to_move == PLAYER_1) ? board_1 : board_2;
 		int type = move.type;
 		switch(type) {
@@ -819,7 +1040,7 @@ float markerScore(uint128_t b, std::vector<uint128_t> rings){
 		}
 	}
   
-	ostream &to_stream(ostream &os) const override {
+	ostream &to_stream(ostream &os) const {
 		for (int i = 0; i <= 19; i++) {
 			for (int j = 0; j < 11; j++) {
 				if (i == 0) {
@@ -876,7 +1097,7 @@ float markerScore(uint128_t b, std::vector<uint128_t> rings){
 		return os;
 	}
 
-	bool operator==(const YinshState &other) const override {
+	bool operator==(const YinshState &other) const {
 		return board_1 == other.board_1 && board_2 == other.board_2 &&
 			   player_to_move == other.player_to_move &&
 			   no_of_markers_remaining == other.no_of_markers_remaining &&
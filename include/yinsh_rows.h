@@ -0,0 +1,92 @@
+#ifndef yinsh_rows
+#define yinsh_rows
+
+#include <vector>
+
+#include "./uint128.h"
+#include "./mappings.h"
+
+/**
+ * Bitboard logic over the 5-cell row windows, kept apart from YinshState so it can
+ * be checked on hand-built positions. Marker boards never include the rings.
+ */
+
+// Own and enemy markers after the ring on ring_pos moves to ring_dest, and the cells
+// whose marker changes: a marker is left on ring_pos and the jumped markers flip.
+inline void markers_after_ring_move(uint128_t markers, uint128_t enemy_markers,
+									uint128_t ring_pos, uint128_t ring_dest,
+									uint128_t& markers_after,
+									uint128_t& enemy_markers_after,
+									uint128_t& changed) {
+	auto flip_mask = flip_bitmasks.find(ring_pos)->second.find(ring_dest)->second;
+	changed = ring_pos | (flip_mask & (markers | enemy_markers));
+	markers_after = (markers & ~flip_mask) | (enemy_markers & flip_mask) | ring_pos;
+	enemy_markers_after = (enemy_markers & ~flip_mask) | (markers & flip_mask);
+}
+
+// Whether one ring move could fill the window with the player's markers. Its ring either
+// sits in the window, leaves a marker there and flips the enemy markers between it and
+// one end, or comes from outside and flips the single enemy marker it crosses, or all five
+// along the window's line. Empty cells and other rings cannot be filled. Whether the jump
+// itself is legal is not checked.
+inline bool is_window_completable(uint128_t window, uint128_t markers,
+								  uint128_t rings, uint128_t enemy_markers) {
+	if((window & ~(markers | rings | enemy_markers)) != 0 || (markers & window) == window)
+		return false;
+	uint128_t to_flip = window & enemy_markers;
+	uint128_t ring = window & rings;
+	if(ring == 0)
+		return popcount(to_flip) == 1 || to_flip == window;
+	if(popcount(ring) > 1)
+		return false;
+	// Bit indices grow along the window, so the cells below the ring lie on one side
+	uint128_t below = window & (ring - 1);
+	uint128_t above = window & ~below & ~ring;
+	return to_flip == 0 || to_flip == below || to_flip == above;
+}
+
+// Row windows the player could fill by one ring move. Rows already formed are left
+// to the pending removal.
+inline std::vector<uint128_t> completable_row_windows(uint128_t markers, uint128_t rings,
+													  uint128_t enemy_markers) {
+	std::vector<uint128_t> windows;
+	for(auto window: row_windows) {
+		if(is_window_completable(window, markers, rings, enemy_markers)) {
+			windows.push_back(window);
+		}
+	}
+	return windows;
+}
+
+// Whether the markers after a ring move fill one of the windows
+inline bool fills_window(const std::vector<uint128_t>& windows, uint128_t markers_after) {
+	for(auto window: windows) {
+		if((markers_after & window) == window) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Whether after our ring move the enemy cannot fill any row window by its next ring move.
+// Threats the move left untouched stay open, and only windows it changed can have
+// become completable or even been filled for the enemy.
+inline bool blocks_threats(const std::vector<uint128_t>& threats, uint128_t changed,
+						   uint128_t markers_after, uint128_t enemy_markers_after,
+						   uint128_t enemy_rings) {
+	for(auto window: threats) {
+		if((window & changed) == 0) {
+			return false;
+		}
+	}
+	for(auto window: row_windows) {
+		if((window & changed) != 0 &&
+		   ((enemy_markers_after & window) == window ||
+			is_window_completable(window, enemy_markers_after, enemy_rings, markers_after))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+#endif
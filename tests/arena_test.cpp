@@ -0,0 +1,53 @@
+// Arena allocation stops at the capacity for good and only allocates the blocks it uses.
+// A search whose arena cannot take the root's children still answers with a legal move.
+
+#include "tic_tac_toe.h"
+
+#define CHECK(condition) \
+    if (!(condition)) { \
+        cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << endl; \
+        return 1; \
+    }
+
+int main() {
+    const int block = 1 << ARENA_BLOCK_BITS;
+    Arena<MCTSNode> arena;
+    arena.reserve(3 * block);
+    CHECK(arena.allocated_bytes() == 0);
+
+    // A block straddling allocation gets both blocks
+    CHECK(arena.allocate(block - 1) == 0);
+    CHECK(arena.allocate(2) == block - 1);
+    CHECK(arena.allocated_bytes() == 2 * block * sizeof(MCTSNode));
+
+    // Once full, failed allocations leave the counter at the capacity
+    CHECK(arena.allocate(2 * block) == -1);
+    CHECK(arena.allocate(2 * block - 1) == block + 1);
+    for (int i = 0; i < 1000000; ++i) {
+        CHECK(arena.allocate(1) == -1);
+    }
+    CHECK(arena.size() == 3 * block);
+
+    // Items come back value-initialized after a reset
+    arena[5].visits = 7;
+    arena.reset();
+    CHECK(arena.allocate(10) == 0);
+    CHECK(arena[5].visits == 0);
+
+    arena.release();
+    CHECK(arena.allocated_bytes() == 0);
+
+    // Without a simulation or room for the children the root stays unexpanded
+    TicTacToeState state("____/111_/22__/2___", TIC_TAC_TOE_PLAYER_1);
+    MonteCarloTreeSearch<TicTacToeState, TicTacToeMove> no_simulations(0.1, 0);
+    MonteCarloTreeSearch<TicTacToeState, TicTacToeMove> no_room(0.1, MAX_SIMULATIONS, false, 1, 1);
+    for (auto *algorithm : {&no_simulations, &no_room}) {
+        CHECK(algorithm->get_move(&state) == TicTacToeMove(1, 3));
+        CHECK(algorithm->get_most_visited_child(0) == -1);
+    }
+    // Split between four trees, four nodes leave each tree its root only
+    EnsembleMonteCarloTreeSearch<TicTacToeState, TicTacToeMove> ensemble(0.1, 4, MAX_SIMULATIONS, false, 4);
+    CHECK(ensemble.get_move(&state) == TicTacToeMove(1, 3));
+    cout << "arena_test: ok" << endl;
+    return 0;
+}
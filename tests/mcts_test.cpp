@@ -0,0 +1,164 @@
+// MonteCarloTreeSearch features that are off by default, checked on 4x4 tic-tac-toe.
+
+#include <cmath>
+
+#include "tic_tac_toe.h"
+
+#define CHECK(condition) \
+    if (!(condition)) { \
+        cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << endl; \
+        return 1; \
+    }
+
+typedef MonteCarloTreeSearch<TicTacToeState, TicTacToeMove> MCTS;
+
+static bool near(double a, double b) {
+    return fabs(a - b) < 1e-9;
+}
+
+// Every simulation credits the AMAF statistics of the root children whose move the root
+// player made anywhere in it, and UCT blends them in with beta = sqrt(k / (3n + k)).
+static int check_rave() {
+    const TicTacToeState root;
+
+    // A single simulation: the root player made 4 to 8 moves, each credited with the result
+    MCTS single(1, 1, false, 1, MCTS_MAX_NODES, 0, 300);
+    single.get_move(&root);
+    const MCTSNode &root_node = single.nodes[0];
+    const int first_child = root_node.first_child;
+    CHECK(first_child >= 0 && root_node.visits == 1);
+    int credited = 0;
+    for (int i = first_child; i < first_child + root_node.child_count; ++i) {
+        const MCTSNode &child = single.nodes[i];
+        CHECK(child.amaf_visits <= 1);
+        if (child.visits == 1) {
+            CHECK(child.amaf_visits == 1);
+        }
+        if (child.amaf_visits == 1) {
+            CHECK(child.amaf_score == root_node.score);
+            ++credited;
+        }
+    }
+    CHECK(credited >= 4 && credited <= 8);
+
+    // Many simulations: a child's AMAF count includes its own visits
+    MCTS rave(1, 500, false, 1, MCTS_MAX_NODES, 0, 300);
+    rave.get_move(&root);
+    long long amaf_visits = 0;
+    for (int i = rave.nodes[0].first_child; i < rave.nodes[0].first_child + rave.nodes[0].child_count; ++i) {
+        const MCTSNode &child = rave.nodes[i];
+        CHECK(child.amaf_visits >= child.visits);
+        CHECK(child.amaf_score <= child.amaf_visits);
+        amaf_visits += child.amaf_visits;
+    }
+    CHECK(amaf_visits >= 4 * 500 && amaf_visits <= 8 * 500);
+
+    // Beta is sqrt(1 / 2) at n = k / 3 and fades as the child's own visits grow
+    MCTSNode &child = rave.nodes[rave.nodes[0].first_child];
+    child.amaf_visits = 50;
+    child.amaf_score = 45;
+    const pair<unsigned, double> betas[] = {{100, sqrt(0.5)}, {10000, sqrt(300.0 / 30300)}};
+    for (const auto &beta : betas) {
+        child.visits = beta.first;
+        child.score = 0.25 * beta.first;
+        CHECK(near(rave.get_uct(rave.nodes[0].first_child, 0), (1 - beta.second) * 0.25 + beta.second * 0.9));
+    }
+    child.amaf_visits = 0;
+    child.amaf_score = 0;
+    CHECK(near(rave.get_uct(rave.nodes[0].first_child, 0), 0.25));
+
+    // Off by default: no AMAF statistics and UCT on the child's own value
+    MCTS plain(1, 500);
+    plain.get_move(&root);
+    for (int i = plain.nodes[0].first_child; i < plain.nodes[0].first_child + plain.nodes[0].child_count; ++i) {
+        CHECK(plain.nodes[i].amaf_visits == 0);
+    }
+    return 0;
+}
+
+// A node with n visits admits its ceil(k * n^alpha) best ranked children. Tic-tac-toe
+// moves are all quiet to the default score_move, so ties keep the legal move order.
+static int check_widening() {
+    const TicTacToeState root;
+    MCTS widening(1, 30, false, 1, MCTS_MAX_NODES, 0, 0, 1, 0.5);
+    widening.get_move(&root);
+    MCTSNode &root_node = widening.nodes[0];
+    const int first_child = root_node.first_child;
+    CHECK(root_node.child_count == 16);
+    for (int i = 0; i < root_node.child_count; ++i) {
+        CHECK(widening.nodes[first_child + i].rank == i);
+    }
+
+    // 30 visits admit ceil(sqrt(30)) = 6 children, the rest were never visited
+    CHECK(root_node.visits == 30);
+    CHECK(widening.get_admitted_children(0) == 6);
+    for (int i = first_child; i < first_child + root_node.child_count; ++i) {
+        CHECK((widening.nodes[i].visits > 0) == (widening.nodes[i].rank < 6));
+    }
+
+    const pair<unsigned, int> admitted[] = {{0, 1}, {1, 1}, {4, 2}, {5, 3}, {64, 8}, {1000, 16}};
+    for (const auto &a : admitted) {
+        root_node.visits = a.first;
+        CHECK(widening.get_admitted_children(0) == a.second);
+    }
+
+    // Off by default: every child is admitted and visited in turn
+    MCTS plain(1, 30);
+    plain.get_move(&root);
+    CHECK(plain.get_admitted_children(0) == 16);
+    for (int i = plain.nodes[0].first_child; i < plain.nodes[0].first_child + 16; ++i) {
+        CHECK(plain.nodes[i].visits > 0);
+    }
+    return 0;
+}
+
+// The position two plies below the root keeps the statistics of its subtree, others start over
+static int check_tree_reuse() {
+    const TicTacToeState root;
+    MCTS mcts(1, 500);
+    mcts.get_move(&root);
+    TicTacToeState state = root.clone();
+    const int i = mcts.get_most_visited_child(0);
+    CHECK(i >= 0);
+    state.make_move(state.get_legal_moves()[i]);
+    const int child = mcts.nodes[0].first_child + i;
+    const int j = mcts.get_most_visited_child(child);
+    CHECK(j >= 0);
+    state.make_move(state.get_legal_moves()[j]);
+    const int grandchild = mcts.nodes[child].first_child + j;
+
+    const unsigned visits = mcts.nodes[grandchild].visits;
+    const int first_child = mcts.nodes[grandchild].first_child;
+    CHECK(visits > 1 && first_child >= 0);
+    vector<unsigned> child_visits;
+    for (int k = first_child; k < first_child + mcts.nodes[grandchild].child_count; ++k) {
+        child_visits.push_back(mcts.nodes[k].visits);
+    }
+    mcts.read_log();
+
+    // The new root starts from the subtree's visits and its children from theirs
+    mcts.get_move(&state);
+    CHECK(mcts.read_log().find("reused visits: " + to_string(visits) + " ") != string::npos);
+    CHECK(mcts.nodes[0].visits == visits + 500);
+    CHECK(mcts.nodes[0].child_count == (int) child_visits.size());
+    unsigned total = 0;
+    for (int k = 0; k < (int) child_visits.size(); ++k) {
+        CHECK(mcts.get_root_visits(k) >= child_visits[k]);
+        total += mcts.get_root_visits(k) - child_visits[k];
+    }
+    CHECK(total == 500);
+
+    // The empty board is not below the new root, the tree is built anew
+    mcts.get_move(&root);
+    CHECK(mcts.read_log().find("reused visits: 0 ") != string::npos);
+    CHECK(mcts.nodes[0].visits == 500);
+    return 0;
+}
+
+int main() {
+    if (check_rave() || check_widening() || check_tree_reuse()) {
+        return 1;
+    }
+    cout << "mcts_test: ok" << endl;
+    return 0;
+}
@@ -0,0 +1,199 @@
+// Minimax on positions where the player to move does not always alternate,
+// and its principal variations on 4x4 tic-tac-toe.
+
+#include "tic_tac_toe.h"
+
+#define CHECK(condition) \
+    if (!(condition)) { \
+        cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << endl; \
+        return 1; \
+    }
+
+static const char STONES_PLAYER_1 = '1';
+static const char STONES_PLAYER_2 = '2';
+static const int STONES_WIN = 1000;
+
+struct StonesMove : public Move<StonesMove> {
+    int taken = 1;
+
+    StonesMove() {}
+
+    StonesMove(int taken) : taken(taken) {}
+
+    void read(istream &stream = cin) override {
+        stream >> taken;
+    }
+
+    ostream &to_stream(ostream &os) const override {
+        return os << taken;
+    }
+
+    bool operator==(const StonesMove &rhs) const override {
+        return taken == rhs.taken;
+    }
+
+    size_t hash() const override {
+        return taken;
+    }
+};
+
+// Players take 1 or 2 stones from a pile and whoever takes the last one wins.
+// Taking 2 earns another turn, like completing a row in Yinsh, so the player
+// to move always wins: 2 at a time, and a single 1 if the pile is odd.
+struct StonesState : public State<StonesState, StonesMove> {
+    int pile;
+    char winner = 0;
+
+    StonesState(int pile) : State(STONES_PLAYER_1), pile(pile) {}
+
+    StonesState clone() const {
+        return *this;
+    }
+
+    int get_goodness() const {
+        if (winner == 0) {
+            return 0;
+        }
+        return winner == player_to_move ? STONES_WIN : -STONES_WIN;
+    }
+
+    vector<StonesMove> get_legal_moves(int max_moves = INF) const {
+        vector<StonesMove> moves;
+        for (int taken = 1; taken <= min(pile, 2) && moves.size() < max_moves; ++taken) {
+            moves.push_back(StonesMove(taken));
+        }
+        return moves;
+    }
+
+    // Extra turns are what quiescence has to follow
+    vector<StonesMove> get_forcing_moves() const {
+        return pile >= 2 ? vector<StonesMove>{StonesMove(2)} : vector<StonesMove>();
+    }
+
+    char get_enemy(char player) const {
+        return player == STONES_PLAYER_1 ? STONES_PLAYER_2 : STONES_PLAYER_1;
+    }
+
+    bool is_winner(char player) const {
+        return winner == player;
+    }
+
+    bool is_terminal() const {
+        return pile == 0;
+    }
+
+    void make_move(const StonesMove &move) {
+        pile -= move.taken;
+        if (pile == 0) {
+            winner = player_to_move;
+        }
+        if (move.taken == 1) {
+            player_to_move = get_enemy(player_to_move);
+        }
+    }
+
+    void undo_move(const StonesMove &move) {
+        if (move.taken == 1) {
+            player_to_move = get_enemy(player_to_move);
+        }
+        pile += move.taken;
+        winner = 0;
+    }
+
+    ostream &to_stream(ostream &os) const {
+        return os << pile << " " << player_to_move << "\n";
+    }
+
+    bool operator==(const StonesState &other) const {
+        return pile == other.pile && player_to_move == other.player_to_move && winner == other.winner;
+    }
+
+    size_t hash() const {
+        return (pile * 3 + (winner == 0 ? 0 : winner == STONES_PLAYER_1 ? 1 : 2)) * 2 + (player_to_move == STONES_PLAYER_1);
+    }
+};
+
+typedef Minimax<StonesState, StonesMove> StonesMinimax;
+
+// Values after a move that keeps the turn are not negated
+static int check_extra_turns() {
+    for (int pile = 2; pile <= 9; ++pile) {
+        StonesState state(pile);
+        StonesMinimax minimax(0.2);
+        CHECK(minimax.get_move(&state) == StonesMove(2));
+        CHECK(minimax.depth_stats.back().goodness == STONES_WIN);
+    }
+
+    // A leaf with an extra turn left: quiescence takes the last two stones
+    StonesState state(2);
+    StonesMinimax minimax(1);
+    minimax.time_manager.start(1);
+    CHECK(minimax.quiesce(&state, -INF, INF, 0, 0) == STONES_WIN);
+    return 0;
+}
+
+// Every iteration's PV is a line of legal moves as long as the depth, starting with the best move
+static int check_pv() {
+    const TicTacToeState root;
+    Minimax<TicTacToeState, TicTacToeMove> minimax(10);
+    minimax.time_manager.start(10);
+    minimax.reset_ordering();
+    int previous_goodness = 0;
+    long long tt_cuts = 0;
+    for (int depth = 1; depth <= 10; ++depth) {
+        minimax.reset_stats();
+        TicTacToeState clone = root.clone();
+        const auto result = minimax.aspiration_search(&clone, depth, previous_goodness);
+        CHECK(result.completed);
+        previous_goodness = result.goodness;
+        tt_cuts += minimax.stats.tt_cuts + minimax.stats.tt_exacts;
+        const auto pv = minimax.get_pv();
+        CHECK(pv.size() == depth);
+        CHECK(pv[0] == result.best_move);
+        TicTacToeState state = root.clone();
+        for (const auto &move : pv) {
+            const auto legal_moves = state.get_legal_moves();
+            CHECK(find(legal_moves.begin(), legal_moves.end(), move) != legal_moves.end());
+            state.make_move(move);
+        }
+        minimax.seed_pv();
+    }
+    // The zero-window searches did cut on the table
+    CHECK(tt_cuts > 0);
+    return 0;
+}
+
+// Each line starts with a root move of its own, the lines come in order of goodness
+static int check_multi_pv() {
+    // Only (1, 3) completes the second row
+    const TicTacToeState root("____/111_/22__/2___", TIC_TAC_TOE_PLAYER_1);
+    Minimax<TicTacToeState, TicTacToeMove> minimax(0.3, INF, TT_MEGABYTES, false, 1, 3);
+    const auto move = minimax.get_move(&root);
+    const auto &lines = minimax.multi_pv_lines;
+    CHECK(lines.size() == 3);
+    CHECK(move == TicTacToeMove(1, 3) && lines[0].move == move);
+    CHECK(lines[0].goodness > lines[1].goodness && lines[1].goodness >= lines[2].goodness);
+    const auto legal_moves = root.get_legal_moves();
+    for (int k = 0; k < 3; ++k) {
+        CHECK(!lines[k].pv.empty() && lines[k].pv[0] == lines[k].move);
+        CHECK(find(legal_moves.begin(), legal_moves.end(), lines[k].move) != legal_moves.end());
+        for (int l = 0; l < k; ++l) {
+            CHECK(!(lines[l].move == lines[k].move));
+        }
+    }
+
+    // No more lines than root moves
+    Minimax<TicTacToeState, TicTacToeMove> narrow(0.3, 2, TT_MEGABYTES, false, 1, 3);
+    narrow.get_move(&root);
+    CHECK(narrow.multi_pv_lines.size() == 2);
+    CHECK(!(narrow.multi_pv_lines[0].move == narrow.multi_pv_lines[1].move));
+    return 0;
+}
+
+int main() {
+    if (check_extra_turns() || check_pv() || check_multi_pv()) {
+        return 1;
+    }
+    cout << "minimax_test: ok" << endl;
+    return 0;
+}
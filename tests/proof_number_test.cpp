@@ -0,0 +1,46 @@
+// df-pn on 4x4 tic-tac-toe: a fork that wins in three plies, and the table
+// keeping depth-limited disproofs to the plies they hold for.
+
+#include "tic_tac_toe.h"
+#include "proof_number.hpp"
+
+#define CHECK(condition) \
+    if (!(condition)) { \
+        cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << endl; \
+        return 1; \
+    }
+
+typedef ProofNumberSearch<TicTacToeState, TicTacToeMove> Solver;
+
+int main() {
+    // Only (0, 0) opens both the top row and the left column, the enemy blocks one of them
+    const TicTacToeState fork("_11_/1_2_/12_2/___2", TIC_TAC_TOE_PLAYER_1);
+    Solver solver(1);
+    const auto result = solver.solve(&fork, 1);
+    CHECK(result.value == ProofValue::WIN);
+    CHECK(result.move == TicTacToeMove(0, 0));
+    CHECK(solver.get_move(&fork) == TicTacToeMove(0, 0));
+
+    // Every answer of the enemy loses
+    TicTacToeState after = fork.clone();
+    after.make_move(TicTacToeMove(0, 0));
+    CHECK(solver.solve(&after, 1).value == ProofValue::LOSS);
+
+    // Without the fork the enemy holds: nothing is proven for either side
+    const TicTacToeState blocked("_112/1_2_/12__/___2", TIC_TAC_TOE_PLAYER_1);
+    CHECK(solver.solve(&blocked, 1).value == ProofValue::UNKNOWN);
+
+    // A disproof found at ply 3 holds for deeper plies only
+    ProofTable table(1);
+    uint32_t pn, dn;
+    table.store(42, PN_INF, 0, 10, 3);
+    table.probe(42, 5, pn, dn);
+    CHECK(pn == PN_INF && dn == 0);
+    table.probe(42, 1, pn, dn);
+    CHECK(pn == 1 && dn == 1);
+    table.store(42, 0, PN_INF, 10, 3);
+    table.probe(42, 1, pn, dn);
+    CHECK(pn == 0 && dn == PN_INF);
+    cout << "proof_number_test: ok" << endl;
+    return 0;
+}
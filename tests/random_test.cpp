@@ -0,0 +1,84 @@
+// Random: xoshiro256** and its splitmix64 seeding against outputs of the reference
+// implementations, the jump to a disjoint stream, and bounded draws.
+
+#include "gtsa.hpp"
+
+#define CHECK(condition) \
+    if (!(condition)) { \
+        cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << endl; \
+        return 1; \
+    }
+
+static int check_known_answers() {
+    // The reference xoshiro256** started from the state {1, 2, 3, 4}
+    Random random;
+    const uint64_t state[] = {1, 2, 3, 4};
+    copy(state, state + 4, random.s);
+    const uint64_t outputs[] = {11520, 0, 1509978240, 1215971899390074240};
+    for (uint64_t output : outputs) {
+        CHECK(random.next() == output);
+    }
+
+    // The state of seed 0 is the first four outputs of splitmix64 started from 0
+    Random seeded(0);
+    const uint64_t splitmix[] = {0xe220a8397b1dcdaf, 0x6e789e6aa1b965f4, 0x06c45d188009454f, 0xf88bb8a8724c81ec};
+    CHECK(equal(splitmix, splitmix + 4, seeded.s));
+    CHECK(seeded.next() == 0x99ec5f36cb75f2b4);
+    CHECK(seeded.next() == 0xbf6e1f784956452a);
+    CHECK(seeded.next() == 0x1a5f849d4933e6e0);
+
+    Random other(42);
+    CHECK(other.next() == 0x15780b2e0c2ec716);
+    CHECK(other.next() == 0x6104d9866d113a7e);
+    return 0;
+}
+
+// 2^128 steps ahead: a fixed stream, different from where it started
+static int check_jump() {
+    Random jumped(0);
+    jumped.jump();
+    CHECK(jumped.next() == 0x376215edc846d62c);
+    CHECK(jumped.next() == 0x57c0611de8350ca7);
+
+    Random twice(0);
+    twice.jump();
+    twice.jump();
+    CHECK(twice.next() != 0x376215edc846d62c);
+    return 0;
+}
+
+static int check_uniform() {
+    Random dice(7);
+    const int rolls[] = {5, 2, 6, 6, 6, 6, 1, 1};
+    for (int roll : rolls) {
+        CHECK(dice.uniform(1, 6) == roll);
+    }
+    CHECK(dice.uniform(-1000000000, 1000000000) == -192586948);
+
+    // Every draw in range, every value of a small range drawn about as often
+    Random random(1);
+    const pair<int, int> ranges[] = {{0, 0}, {-3, -3}, {0, 1}, {-5, 5}, {0, 15}, {1, 1000},
+                                     {-1000000000, 1000000000}, {0, INT_MAX - 1}};
+    for (const auto &range : ranges) {
+        for (int i = 0; i < 10000; ++i) {
+            const int value = random.uniform(range.first, range.second);
+            CHECK(value >= range.first && value <= range.second);
+        }
+    }
+    int counts[16] = {};
+    for (int i = 0; i < 160000; ++i) {
+        ++counts[random.uniform(0, 15)];
+    }
+    for (int count : counts) {
+        CHECK(count > 9000 && count < 11000);
+    }
+    return 0;
+}
+
+int main() {
+    if (check_known_answers() || check_jump() || check_uniform()) {
+        return 1;
+    }
+    cout << "random_test: ok" << endl;
+    return 0;
+}
@@ -0,0 +1,169 @@
+// SearchStats::to_json writes one valid JSON object per line, whatever the move prints.
+
+#include "tic_tac_toe.h"
+#include <cstring>
+#include <map>
+
+// Strict recursive descent over one JSON value, string values keep their decoded text
+struct JsonChecker {
+    const string &text;
+    size_t i = 0;
+    map<string, string> strings;
+
+    JsonChecker(const string &text) : text(text) {}
+
+    bool parse_line() {
+        return value("") && i == text.size();
+    }
+
+    bool value(const string &key) {
+        if (i >= text.size()) {
+            return false;
+        }
+        if (text[i] == '{') {
+            return object();
+        }
+        if (text[i] == '[') {
+            return array();
+        }
+        if (text[i] == '"') {
+            string decoded;
+            if (!string_literal(decoded)) {
+                return false;
+            }
+            strings[key] = decoded;
+            return true;
+        }
+        return number();
+    }
+
+    bool object() {
+        ++i;
+        if (i < text.size() && text[i] == '}') {
+            ++i;
+            return true;
+        }
+        while (true) {
+            string key;
+            if (i >= text.size() || text[i] != '"' || !string_literal(key) ||
+                i >= text.size() || text[i++] != ':' || !value(key) || i >= text.size()) {
+                return false;
+            }
+            if (text[i] == '}') {
+                ++i;
+                return true;
+            }
+            if (text[i++] != ',') {
+                return false;
+            }
+        }
+    }
+
+    bool array() {
+        ++i;
+        if (i < text.size() && text[i] == ']') {
+            ++i;
+            return true;
+        }
+        while (true) {
+            if (!value("") || i >= text.size()) {
+                return false;
+            }
+            if (text[i] == ']') {
+                ++i;
+                return true;
+            }
+            if (text[i++] != ',') {
+                return false;
+            }
+        }
+    }
+
+    bool string_literal(string &decoded) {
+        ++i;
+        while (i < text.size() && text[i] != '"') {
+            const unsigned char c = text[i++];
+            if (c < 0x20) {
+                return false;
+            }
+            if (c != '\\') {
+                decoded += c;
+                continue;
+            }
+            if (i >= text.size()) {
+                return false;
+            }
+            const char escaped = text[i++];
+            if (escaped == 'u') {
+                if (i + 4 > text.size()) {
+                    return false;
+                }
+                decoded += (char) stoi(text.substr(i, 4), nullptr, 16);
+                i += 4;
+            } else if (escaped == 'n') {
+                decoded += '\n';
+            } else if (escaped == 'r') {
+                decoded += '\r';
+            } else if (escaped == 't') {
+                decoded += '\t';
+            } else if (escaped == '"' || escaped == '\\' || escaped == '/') {
+                decoded += escaped;
+            } else {
+                return false;
+            }
+        }
+        return i++ < text.size();
+    }
+
+    bool number() {
+        const size_t start = i;
+        while (i < text.size() && (isdigit(text[i]) || strchr("+-.eE", text[i]) != nullptr)) {
+            ++i;
+        }
+        if (start == i) {
+            return false;
+        }
+        try {
+            stod(text.substr(start, i - start));
+        } catch (const exception &) {
+            return false;
+        }
+        return true;
+    }
+};
+
+#define CHECK(condition) \
+    if (!(condition)) { \
+        cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << endl; \
+        return 1; \
+    }
+
+int main() {
+    // A move printed the way YinshMove prints one, with control characters around it
+    SearchStats stats;
+    stats.move = "Ring placed at (1, 2)\tand \"is\" a type 1 move!\\\r\n\x01";
+    stringstream stream;
+    stats.to_json(stream);
+    string line;
+    CHECK(getline(stream, line));
+    CHECK(stream.peek() == EOF);
+    JsonChecker checker(line);
+    CHECK(checker.parse_line());
+    CHECK(checker.strings["move"] == stats.move);
+
+    // Every iteration of a real search is one parsable line
+    Minimax<TicTacToeState, TicTacToeMove> minimax(0.2);
+    stringstream lines;
+    minimax.stats_stream = &lines;
+    const TicTacToeState root;
+    minimax.get_move(&root);
+    int count = 0;
+    while (getline(lines, line)) {
+        JsonChecker checker(line);
+        CHECK(checker.parse_line());
+        ++count;
+    }
+    CHECK(count == minimax.depth_stats.size() && count > 0);
+    cout << "search_stats_test: " << count << " lines parsed" << endl;
+    return 0;
+}
@@ -0,0 +1,135 @@
+// TranspositionTable: entries come back as stored, slots whose two words do not
+// belong together are rejected, and full buckets keep the deeper entries of the
+// current search before anything left from earlier ones.
+
+#include "gtsa.hpp"
+
+#define CHECK(condition) \
+    if (!(condition)) { \
+        cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << endl; \
+        return 1; \
+    }
+
+// Keys of one bucket, they differ above the bucket index bits
+static size_t key_in_bucket(const TranspositionTable &table, int i) {
+    return 5 + i * table.bucket_count;
+}
+
+static int check_store_probe() {
+    TranspositionTable table(1);
+    TTEntry entry;
+    CHECK(!table.probe(12345, entry));
+
+    table.store(12345, 77, 9, -321, TTEntryType::LOWER_BOUND);
+    CHECK(table.probe(12345, entry));
+    CHECK(entry.move == 77 && entry.depth == 9 && entry.value == -321);
+    CHECK(entry.value_type == TTEntryType::LOWER_BOUND);
+    CHECK(!table.probe(12345 + table.bucket_count, entry));
+
+    // A result much shallower than the stored one is dropped unless it is exact,
+    // and a store without a move keeps the stored move
+    table.store(12345, 78, 5, 10, TTEntryType::UPPER_BOUND);
+    CHECK(table.probe(12345, entry) && entry.depth == 9 && entry.move == 77);
+    table.store(12345, NO_MOVE, 5, 10, TTEntryType::EXACT_VALUE);
+    CHECK(table.probe(12345, entry) && entry.depth == 5 && entry.move == 77);
+    CHECK(entry.value_type == TTEntryType::EXACT_VALUE);
+
+    table.clear();
+    CHECK(!table.probe(12345, entry));
+    return 0;
+}
+
+// A writer updates the two words of a slot one after the other
+static int check_torn_slot() {
+    TranspositionTable table(1);
+    TTEntry entry;
+    const size_t key = 987654321;
+    table.store(key, 3, 4, 50, TTEntryType::EXACT_VALUE);
+    TranspositionTable::Slot *slot = nullptr;
+    for (auto &s : table.bucket(key).slots) {
+        if (!TranspositionTable::is_empty(s.data.load())) {
+            slot = &s;
+        }
+    }
+    CHECK(slot != nullptr);
+    const uint64_t data = slot->data.load();
+    const uint64_t key_xor_data = slot->key_xor_data.load();
+
+    // New data with the old key word, as if read between the two stores
+    slot->data.store(TranspositionTable::pack(TTEntry(3, 4, 51, TTEntryType::EXACT_VALUE)));
+    CHECK(!table.probe(key, entry));
+    // The old data with the key word of another position's entry
+    slot->data.store(data);
+    slot->key_xor_data.store(key_xor_data ^ 1);
+    CHECK(!table.probe(key, entry));
+    slot->key_xor_data.store(key_xor_data);
+    CHECK(table.probe(key, entry) && entry.value == 50);
+    return 0;
+}
+
+// The shallowest slot of a full bucket goes first
+static int check_replacement() {
+    TranspositionTable table(1);
+    TTEntry entry;
+    const int depths[] = {6, 2, 8, 4};
+    for (int i = 0; i < TranspositionTable::BUCKET_SLOTS; ++i) {
+        table.store(key_in_bucket(table, i), i + 1, depths[i], i, TTEntryType::EXACT_VALUE);
+    }
+    for (int i = 0; i < TranspositionTable::BUCKET_SLOTS; ++i) {
+        CHECK(table.probe(key_in_bucket(table, i), entry) && entry.depth == depths[i]);
+    }
+    table.store(key_in_bucket(table, 4), 5, 3, 4, TTEntryType::EXACT_VALUE);
+    CHECK(table.probe(key_in_bucket(table, 4), entry) && entry.depth == 3);
+    CHECK(!table.probe(key_in_bucket(table, 1), entry));
+    for (int i : {0, 2, 3}) {
+        CHECK(table.probe(key_in_bucket(table, i), entry) && entry.depth == depths[i]);
+    }
+    return 0;
+}
+
+// Every root search starts a generation, entries not hit since are evicted first
+static int check_generations() {
+    TranspositionTable table(1);
+    TTEntry entry;
+    for (int i = 0; i < TranspositionTable::BUCKET_SLOTS; ++i) {
+        table.store(key_in_bucket(table, i), i + 1, 10, i, TTEntryType::EXACT_VALUE);
+    }
+    CHECK(table.fill_rate() > 0);
+    table.new_search();
+    CHECK(table.fill_rate() == 0);
+
+    // A hit refreshes the entry, a shallow store then replaces one of the stale ones
+    CHECK(table.probe(key_in_bucket(table, 0), entry) && entry.age == 0);
+    CHECK(table.probe(key_in_bucket(table, 0), entry) && entry.age == 1);
+    table.store(key_in_bucket(table, 4), 5, 1, 4, TTEntryType::EXACT_VALUE);
+    CHECK(table.probe(key_in_bucket(table, 4), entry) && entry.depth == 1);
+    CHECK(table.probe(key_in_bucket(table, 0), entry) && entry.depth == 10);
+    int stale = 0;
+    for (int i = 1; i < TranspositionTable::BUCKET_SLOTS; ++i) {
+        stale += table.probe(key_in_bucket(table, i), entry);
+    }
+    CHECK(stale == TranspositionTable::BUCKET_SLOTS - 2);
+
+    // A shallow bound of the current search replaces a deep one of an earlier search
+    table.store(key_in_bucket(table, 0), 9, 2, 7, TTEntryType::LOWER_BOUND);
+    CHECK(table.probe(key_in_bucket(table, 0), entry) && entry.depth == 10);
+    table.new_search();
+    table.store(key_in_bucket(table, 0), 9, 2, 7, TTEntryType::LOWER_BOUND);
+    CHECK(table.probe(key_in_bucket(table, 0), entry) && entry.depth == 2 && entry.age == 2);
+
+    // Ages wrap around after AGE_MASK + 1 searches, the generation after the current one is the oldest
+    for (int i = 0; i <= TranspositionTable::AGE_MASK; ++i) {
+        table.new_search();
+    }
+    CHECK(table.generation == 2);
+    CHECK(table.relative_age(1) == 1 && table.relative_age(3) == TranspositionTable::AGE_MASK);
+    return 0;
+}
+
+int main() {
+    if (check_store_probe() || check_torn_slot() || check_replacement() || check_generations()) {
+        return 1;
+    }
+    cout << "transposition_table_test: ok" << endl;
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Row window logic of Yinsh on hand-built positions around the five cells
+// (3,5) (5,5) (7,5) (9,5) (11,5), one vertical line of the board.
+
+#include <algorithm>
+#include <iostream>
+
+#include "yinsh_rows.h"
+
+#define CHECK(condition) \
+    if (!(condition)) { \
+        cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << endl; \
+        return 1; \
+    }
+
+static uint128_t cells(initializer_list<pair<int, int>> coords) {
+    uint128_t board = 0;
+    for (const auto &p : coords) {
+        board |= xytoint(p.first, p.second);
+    }
+    return board;
+}
+
+static bool contains(const vector<uint128_t> &windows, uint128_t window) {
+    return find(windows.begin(), windows.end(), window) != windows.end();
+}
+
+int main() {
+    const uint128_t window = cells({{3, 5}, {5, 5}, {7, 5}, {9, 5}, {11, 5}});
+    CHECK(contains(row_windows, window));
+    uint128_t markers_after, enemy_markers_after, changed;
+
+    // Four markers and a ring on the fifth cell: the ring leaves its marker behind
+    {
+        const uint128_t markers = cells({{3, 5}, {5, 5}, {7, 5}, {9, 5}});
+        const uint128_t rings = cells({{11, 5}, {2, 4}});
+        const auto windows = completable_row_windows(markers, rings, 0);
+        CHECK(contains(windows, window));
+        markers_after_ring_move(markers, 0, xytoint(11, 5), xytoint(12, 6),
+                                markers_after, enemy_markers_after, changed);
+        CHECK((markers_after & window) == window);
+        CHECK(fills_window(windows, markers_after));
+        markers_after_ring_move(markers, 0, xytoint(2, 4), xytoint(4, 4),
+                                markers_after, enemy_markers_after, changed);
+        CHECK(!fills_window(windows, markers_after));
+    }
+
+    // Four markers around an enemy marker, flipped by a ring crossing the line
+    {
+        const uint128_t markers = cells({{3, 5}, {5, 5}, {9, 5}, {11, 5}});
+        const uint128_t enemy_markers = cells({{7, 5}});
+        const uint128_t rings = cells({{6, 4}});
+        const auto windows = completable_row_windows(markers, rings, enemy_markers);
+        CHECK(contains(windows, window));
+        markers_after_ring_move(markers, enemy_markers, xytoint(6, 4), xytoint(8, 6),
+                                markers_after, enemy_markers_after, changed);
+        CHECK(changed == cells({{6, 4}, {7, 5}}));
+        CHECK(enemy_markers_after == 0);
+        CHECK(fills_window(windows, markers_after));
+        markers_after_ring_move(markers, enemy_markers, xytoint(6, 4), xytoint(4, 4),
+                                markers_after, enemy_markers_after, changed);
+        CHECK(!fills_window(windows, markers_after));
+    }
+
+    // A crossing jump flips one cell only, a ring in the window the cells on one side of it
+    {
+        const uint128_t markers = cells({{3, 5}, {9, 5}, {11, 5}});
+        const uint128_t enemy_markers = cells({{5, 5}, {7, 5}});
+        CHECK(!is_window_completable(window, markers, cells({{6, 4}}), enemy_markers));
+        CHECK(!is_window_completable(window, markers, cells({{6, 4}}), cells({{5, 5}})));
+        CHECK(is_window_completable(window, cells({{3, 5}, {5, 5}}), cells({{7, 5}}),
+                                    cells({{9, 5}, {11, 5}})));
+        CHECK(!is_window_completable(window, cells({{3, 5}, {9, 5}}), cells({{7, 5}}),
+                                     cells({{5, 5}, {11, 5}})));
+    }
+
+    // The enemy threatens to flip our marker on (7,5) with its ring on (6,4)
+    {
+        const uint128_t enemy_markers = cells({{3, 5}, {5, 5}, {9, 5}, {11, 5}});
+        const uint128_t enemy_rings = cells({{6, 4}});
+        const uint128_t markers = cells({{7, 5}});
+        const auto threats = completable_row_windows(enemy_markers, enemy_rings, markers);
+        CHECK(contains(threats, window));
+
+        // Flipping (5,5) leaves two of our markers the enemy cannot flip back at once
+        markers_after_ring_move(markers, enemy_markers, xytoint(4, 4), xytoint(6, 6),
+                                markers_after, enemy_markers_after, changed);
+        CHECK(blocks_threats(threats, changed, markers_after, enemy_markers_after, enemy_rings));
+
+        // A move away from the line leaves the threat open
+        markers_after_ring_move(markers, enemy_markers, xytoint(4, 4), xytoint(2, 4),
+                                markers_after, enemy_markers_after, changed);
+        CHECK(!blocks_threats(threats, changed, markers_after, enemy_markers_after, enemy_rings));
+
+        // Flipping (7,5) completes the enemy row instead
+        markers_after_ring_move(markers, enemy_markers, xytoint(8, 4), xytoint(6, 6),
+                                markers_after, enemy_markers_after, changed);
+        CHECK((enemy_markers_after & window) == window);
+        CHECK(!blocks_threats(threats, changed, markers_after, enemy_markers_after, enemy_rings));
+    }
+    cout << "yinsh_rows_test: ok" << endl;
+    return 0;
+}